@@ -53,17 +53,24 @@ void BufHashTbl::insert(const File& file, const PageId pageNo,
 
 void BufHashTbl::lookup(const File& file, const PageId pageNo,
                         FrameId& frameNo) {
+  if (!tryLookup(file, pageNo, frameNo)) {
+    throw HashNotFoundException(file.filename(), pageNo);
+  }
+}
+
+bool BufHashTbl::tryLookup(const File& file, const PageId pageNo,
+                           FrameId& frameNo) {
   int index = hash(file, pageNo);
-  std::shared_ptr<hashBucket> tmpBuc = ht[index];
-  while (tmpBuc) {
+  // Walk the chain through raw pointers; copying each shared_ptr would
+  // touch its reference count on every probe.
+  for (const hashBucket* tmpBuc = ht[index].get(); tmpBuc;
+       tmpBuc = tmpBuc->next.get()) {
     if (tmpBuc->file == file && tmpBuc->pageNo == pageNo) {
       frameNo = tmpBuc->frameNo;  // return frameNo by reference
-      return;
+      return true;
     }
-    tmpBuc = tmpBuc->next;
   }
-
-  throw HashNotFoundException(file.filename(), pageNo);
+  return false;
 }
 
 void BufHashTbl::remove(const File& file, const PageId pageNo) {
@@ -95,6 +95,17 @@ class BufHashTbl {
    */
   void lookup(const File& file, const PageId pageNo, FrameId& frameNo);
 
+  /**
+   * Check if (file, pageNo) is currently in the buffer pool, like lookup(),
+   * but without throwing when it is not.
+   *
+   * @param file  	File object
+   * @param pageNo	Page number in the file
+   * @param frameNo Frame number reference, set if the entry is found
+   * @return true if the entry was found
+   */
+  bool tryLookup(const File& file, const PageId pageNo, FrameId& frameNo);
+
   /**
    * Delete entry (file,pageNo) from hash table.
    *
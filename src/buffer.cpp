@@ -8,19 +8,34 @@
 
 #include "buffer.h"
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <utility>
 
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/hash_not_found_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
+#include "file_iterator.h"
 
 namespace badgerdb {
 
 constexpr int HASHTABLE_SZ(int bufs) { return ((int)(bufs * 1.2) & -2) + 1; }
 
+namespace {
+
+/**
+ * Key of a page in the admission filter's frequency sketch.
+ */
+std::uint64_t sketchKey(const File& file, const PageId pageNo) {
+  return std::hash<std::string>()(file.filename()) * 0x9e3779b97f4a7c15ULL +
+         pageNo;
+}
+
+}  // namespace
+
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
@@ -29,6 +44,10 @@ BufMgr::BufMgr(std::uint32_t bufs)
     : numBufs(bufs),
       hashTable(HASHTABLE_SZ(bufs)),
       bufDescTable(bufs),
+      numDirty(0),
+      dirtiedSinceRound(0),
+      windowFrames(0),
+      flusherStop(false),
       bufPool(bufs) {
   for (FrameId i = 0; i < bufs; i++) {
     bufDescTable[i].frameNo = i;
@@ -36,116 +55,394 @@ BufMgr::BufMgr(std::uint32_t bufs)
   }
 
   clockHand = bufs - 1;
+  flushHand = bufs - 1;
 }
 
+BufMgr::~BufMgr() { stopBackgroundFlusher(); }
+
 void BufMgr::advanceClock() {
   clockHand = (clockHand + 1)%numBufs;
 }
 
 /**
- * @brief Uses the clock algorithm to allocate a free frame
+ * @brief Uses the clock algorithm to allocate a free frame, preferring clean
+ * victims within the eviction policy's candidate window
+ * @param lock lock on poolMutex, released while the victim is written back
+ *             and copied into the cache tiers
  * @param frame frame reference number 
  * @throws BufferExceededExcpetion if all buffer frames are pinned.
  */ 
-void BufMgr::allocBuf(FrameId& frame) {  
+void BufMgr::allocBuf(std::unique_lock<std::mutex>& lock, FrameId& frame) {
   
   unsigned int count = 0;
+  std::uint32_t examined = 0;
+  std::uint32_t bestCost = 0;
+  FrameId victim = 0;
+  bool found = false;
 
   while(count < numBufs){
     advanceClock();
     if(!bufDescTable[clockHand].valid){
       frame = bufDescTable[clockHand].frameNo;
+      if (admissionSketch) {
+        enterWindow(frame);
+      }
       return;
     }
+    else if (bufDescTable[clockHand].probationary){
+      //window pages are not clock candidates
+      count++;
+    }
     else if (bufDescTable[clockHand].refbit){
       bufDescTable[clockHand].refbit = false;
       continue;
     }
-    else if (bufDescTable[clockHand].pinCnt == 0){
-      break;
+    else if (bufDescTable[clockHand].pinCnt == 0 &&
+             !bufDescTable[clockHand].writeInProgress){
+      const std::uint32_t cost =
+          examined + (bufDescTable[clockHand].dirty ? evictionPolicy.dirtyPenalty
+                                                    : 0);
+      if (!found || cost < bestCost) {
+        victim = clockHand;
+        bestCost = cost;
+        found = true;
+      }
+      //later candidates cost at least their position
+      if (++examined >= evictionPolicy.candidateWindow || examined >= bestCost) {
+        break;
+      }
+      count++;
     }else{
       count++;
     }
   }
-  if(count >= numBufs){
+  if (found && bufDescTable[victim].dirty && flushController) {
+    //no clean frame was close; let the background flusher get ahead
+    flusherWake.notify_one();
+  }
+  if (admissionSketch) {
+    found = admitOrEvict(found, victim);
+  }
+  if(!found){
     throw BufferExceededException();
   }
-  //write to disk if the frame is dirty
-  if(bufDescTable[clockHand].dirty){
-      bufDescTable[clockHand].file.writePage(bufPool[clockHand]);
-      frame = bufDescTable[clockHand].frameNo;
+  BufDesc& desc = bufDescTable[victim];
+  frame = desc.frameNo;
+
+  //write the victim back if it is dirty and copy it into the cache tiers,
+  //without holding the pool latch; the frame cannot be pinned, evicted or
+  //flushed while writeInProgress is set
+  std::shared_ptr<CompressedCache> memCache = compressedCache;
+  std::shared_ptr<SecondaryCache> cache = secondaryCache;
+  const bool wasDirty = desc.dirty;
+  const std::uint32_t hits = desc.hits;
+  if (wasDirty || memCache || cache) {
+    desc.writeInProgress = true;
+    if (wasDirty) {
+      desc.dirty = false;
+      numDirty--;
     }
-  else{
-    frame = bufDescTable[clockHand].frameNo;
+    lock.unlock();
+    try {
+      if (wasDirty) {
+        ioScheduler.write(IoClass::FOREGROUND, desc.file, bufPool[victim]);
+      }
+    } catch (...) {
+      lock.lock();
+      desc.writeInProgress = false;
+      desc.dirty = true;
+      numDirty++;
+      ioDone.notify_all();
+      throw;
+    }
+    //keep the evicted page in the compressed tier if it compresses, otherwise
+    //in the secondary cache tier if it earned a second chance
+    const std::string& name = desc.file.filename();
+    const bool compressed =
+        memCache && memCache->insert(name, bufPool[victim]);
+    if (!compressed && cache && cache->shouldAdmit(hits)) {
+      cache->insert(name, bufPool[victim]);
+    }
+    lock.lock();
+    desc.writeInProgress = false;
+    if (wasDirty) {
+      bufStats.diskwrites++;
+    }
+    ioDone.notify_all();
   }
 
-  hashTable.remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-  bufDescTable[clockHand].clear();
-  
-  
+  hashTable.remove(desc.file, desc.pageNo);
+  desc.clear();
+  if (admissionSketch) {
+    enterWindow(frame);
+  }
+}
+
+bool BufMgr::admitOrEvict(const bool haveVictim, FrameId& victim) {
+  if (haveVictim && probationWindow.size() < windowFrames) {
+    return true;
+  }
+  auto candidate = std::find_if(
+      probationWindow.begin(), probationWindow.end(), [this](FrameId f) {
+        return bufDescTable[f].pinCnt == 0 &&
+               !bufDescTable[f].writeInProgress;
+      });
+  if (candidate == probationWindow.end()) {
+    return haveVictim;
+  }
+  const BufDesc& window = bufDescTable[*candidate];
+  const BufDesc& main = bufDescTable[victim];
+  if (haveVictim &&
+      admissionSketch->frequency(sketchKey(window.file, window.pageNo)) >
+          admissionSketch->frequency(sketchKey(main.file, main.pageNo))) {
+    bufDescTable[*candidate].probationary = false;
+  } else {
+    victim = *candidate;
+    bufDescTable[victim].probationary = false;
+  }
+  probationWindow.erase(candidate);
+  return true;
+}
+
+void BufMgr::enterWindow(const FrameId frame) {
+  bufDescTable[frame].probationary = true;
+  probationWindow.push_back(frame);
+  while (probationWindow.size() > windowFrames) {
+    bufDescTable[probationWindow.front()].probationary = false;
+    probationWindow.pop_front();
+  }
+}
+
+void BufMgr::leaveWindow(const FrameId frame) {
+  if (bufDescTable[frame].probationary) {
+    probationWindow.erase(std::find(probationWindow.begin(),
+                                    probationWindow.end(), frame));
+    bufDescTable[frame].probationary = false;
+  }
 }
 
 
 void BufMgr::readPage(File& file, const PageId pageNo, Page*& page) {
+  std::unique_lock<std::mutex> lock(poolMutex);
+  bufStats.accesses++;
+  if (admissionSketch) {
+    admissionSketch->increment(sketchKey(file, pageNo));
+  }
   FrameId frameNo;
-  try {
-    hashTable.lookup(file, pageNo, frameNo);
+  for (;;) {
+    if (!hashTable.tryLookup(file, pageNo, frameNo)) {
+      // Miss: allocBuf() may release the latch to write back its victim, so
+      // another thread may have loaded the page meanwhile.
+      allocBuf(lock, frameNo);
+      FrameId loaded;
+      if (!hashTable.tryLookup(file, pageNo, loaded)) {
+        break;
+      }
+      leaveWindow(frameNo);
+      bufDescTable[frameNo].clear();
+      continue;
+    }
+    if (bufDescTable[frameNo].ioInProgress ||
+        bufDescTable[frameNo].writeInProgress) {
+      // Another thread is already reading this page; wait for it and look the
+      // page up again, since the read may have failed and released the frame.
+      // A page being written back is not pinned until the write completes,
+      // so its image and dirty sectors do not change under the writer.
+      ioDone.wait(lock);
+      continue;
+    }
     bufDescTable[frameNo].refbit = true;
+    bufDescTable[frameNo].hits++;
     bufDescTable[frameNo].pinCnt++;
     page = &bufPool[frameNo];
+    return;
+  }
+
+  // Install the frame before reading so concurrent requesters find it.
+  bufDescTable[frameNo].Set(file, pageNo);
+  bufDescTable[frameNo].ioInProgress = true;
+  hashTable.insert(file, pageNo, frameNo);
+  std::shared_ptr<CompressedCache> memCache = compressedCache;
+  std::shared_ptr<SecondaryCache> cache = secondaryCache;
+  lock.unlock();
+
+  bool cached = false;
+  try {
+    cached = (memCache &&
+              memCache->take(file.filename(), pageNo, bufPool[frameNo])) ||
+             (cache && cache->take(file.filename(), pageNo, bufPool[frameNo]));
+    if (!cached) {
+      ioScheduler.read(IoClass::FOREGROUND, file, pageNo, bufPool[frameNo]);
+    }
+  } catch (...) {
+    lock.lock();
+    hashTable.remove(file, pageNo);
+    leaveWindow(frameNo);
+    bufDescTable[frameNo].clear();
+    ioDone.notify_all();
+    throw;
+  }
+
+  lock.lock();
+  if (cached) {
+    bufStats.cachereads++;
+  } else {
+    bufStats.diskreads++;
+  }
+  bufDescTable[frameNo].ioInProgress = false;
+  ioDone.notify_all();
+  page = &bufPool[frameNo];
+}
 
-  } // if page is not found in buffer pool, catch exception
-  catch (HashNotFoundException &e){
-    allocBuf(frameNo);
-    bufPool[frameNo]= file.readPage(pageNo);
-    bufDescTable[frameNo].Set(file,pageNo);
-    page=&bufPool[frameNo];
-    hashTable.insert(file,pageNo,frameNo);
+void BufMgr::readPage(File& file, const PageId pageNo, Page*& page,
+                      const LatchMode mode) {
+  readPage(file, pageNo, page);
+  bufDescTable[page - &bufPool[0]].latch.lock(mode);
+}
 
+FrameId BufMgr::pinnedFrame(File& file, const PageId pageNo) {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  FrameId frameNo;
+  hashTable.lookup(file, pageNo, frameNo);
+  if (bufDescTable[frameNo].pinCnt == 0) {
+    throw PageNotPinnedException(file.filename(), pageNo, frameNo);
   }
+  return frameNo;
+}
+
+bool BufMgr::tryLatchPage(File& file, const PageId pageNo,
+                          const LatchMode mode) {
+  return bufDescTable[pinnedFrame(file, pageNo)].latch.tryLock(mode);
+}
+
+bool BufMgr::upgradeLatch(File& file, const PageId pageNo) {
+  RWLatch& latch = bufDescTable[pinnedFrame(file, pageNo)].latch;
+  if (latch.tryUpgrade()) {
+    return true;
+  }
+  // Our pin keeps the frame in place while we queue for exclusive access.
+  latch.unlockShared();
+  latch.lockExclusive();
+  return false;
+}
+
+void BufMgr::unPinPage(File& file, const PageId pageNo, const bool dirty,
+                       const LatchMode mode) {
+  // Release the latch first: once unpinned, the frame may be reassigned.
+  bufDescTable[pinnedFrame(file, pageNo)].latch.unlock(mode);
+  unPinPage(file, pageNo, dirty);
 }
 
 void BufMgr::unPinPage(File& file, const PageId pageNo, const bool dirty) {
-  // Define a frameID where page could be located 
-  FrameId pageFrame;
-  try{
-    // Search for page in buffer pool
-    hashTable.lookup(file, pageNo, pageFrame);
-
-    // If pin count is 0, throw exception,
-    if (bufDescTable[pageFrame].pinCnt == 0)
-    {
-      throw PageNotPinnedException("Page not pinned.", pageNo, pageFrame);
-    } // else decrement pin count and set dirty bit if needed.
-    else{
-      bufDescTable[pageFrame].pinCnt--;
-      if (dirty == true)
+  std::chrono::microseconds throttle(0);
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    // Define a frameID where page could be located
+    FrameId pageFrame;
+    try{
+      // Search for page in buffer pool
+      hashTable.lookup(file, pageNo, pageFrame);
+
+      // If pin count is 0, throw exception,
+      if (bufDescTable[pageFrame].pinCnt == 0)
       {
-        bufDescTable[pageFrame].dirty = true;
+        throw PageNotPinnedException("Page not pinned.", pageNo, pageFrame);
+      } // else decrement pin count and set dirty bit if needed.
+      else{
+        bufDescTable[pageFrame].pinCnt--;
+        if (dirty == true)
+        {
+          if (!bufDescTable[pageFrame].dirty)
+          {
+            numDirty++;
+            dirtiedSinceRound++;
+          }
+          bufDescTable[pageFrame].dirty = true;
+          if (flushController)
+          {
+            throttle = flushController->throttleDelay(numDirty, numBufs);
+          }
+        }
       }
+    } // if page is not found in any frame, catch exception
+    catch (HashNotFoundException &e){
+      std::cerr << e.message();
     }
-  } // if page is not found in any frame, catch exception
-  catch (HashNotFoundException &e){
-    std::cerr << e.message();
+  }
+
+  // Dirty pages are piling up faster than the flusher can clean them; hurry
+  // the flusher along and give it time to catch up.
+  if (throttle.count() > 0) {
+    flusherWake.notify_one();
+    std::this_thread::sleep_for(throttle);
   }
 }
 
 void BufMgr::allocPage(File& file, PageId& pageNo, Page*& page) {
+  allocPage(file, pageNo, page, false);
+}
+
+void BufMgr::allocPage(File& file, PageId& pageNo, Page*& page,
+                       const bool deferred) {
+  allocPage(file, Page::INVALID_NUMBER, pageNo, page, deferred);
+}
+
+void BufMgr::allocPage(File& file, const PageId hintPageNo, PageId& pageNo,
+                       Page*& page) {
+  allocPage(file, hintPageNo, pageNo, page, false);
+}
+
+void BufMgr::allocPage(File& file, const PageId hintPageNo, PageId& pageNo,
+                       Page*& page, const bool deferred) {
   FrameId frameNo;
-  Page temp = file.allocatePage();
-  allocBuf(frameNo);
-  bufPool[frameNo] = temp;
-  page = &bufPool[frameNo];
+  Page temp;
+  //temporary files allocate by appending, so their pages exist only in the
+  //frame until written back as well
+  const bool inMemory = deferred || file.isTemporary();
+  ioScheduler.execute(IoClass::FOREGROUND, file,
+                      [&file, &temp, hintPageNo, deferred]() {
+    temp = deferred ? file.reservePage() : file.allocatePage(hintPageNo);
+  });
+  std::unique_lock<std::mutex> lock(poolMutex);
+  bufStats.accesses++;
+  if (!inMemory) {
+    bufStats.diskreads++;
+  }
+  try {
+    allocBuf(lock, frameNo);
+  } catch (...) {
+    if (deferred) {
+      //otherwise the next write to the file would commit the reservation
+      const PageId reserved = temp.page_number();
+      lock.unlock();
+      ioScheduler.execute(IoClass::FOREGROUND, file, [&file, reserved]() {
+        file.dropReservation(reserved);
+      });
+    }
+    throw;
+  }
   pageNo = temp.page_number();
+  bufPool[frameNo] = std::move(temp);
+  page = &bufPool[frameNo];
   hashTable.insert(file, pageNo, frameNo);
   bufDescTable[frameNo].Set(file, pageNo);
+  if (inMemory) {
+    // The frame holds the only copy of the page until it is written back.
+    bufDescTable[frameNo].dirty = true;
+    numDirty++;
+    dirtiedSinceRound++;
+  }
 }
 
-void BufMgr::flushFile(File& file) {
-  //loop through to find frame with file
+std::vector<FrameId> BufMgr::writeBackFile(std::unique_lock<std::mutex>& lock,
+                                           File& file) {
+  waitForWriteBack(lock, [&file](const BufDesc& desc) {
+    return desc.file == file;
+  });
+  //check every frame of the file before writing anything
+  std::vector<FrameId> frames;
   for (FrameId i = 0; i < numBufs; i++)
   {
-    //when file is found, check for exceptions
     if (bufDescTable[i].file == file)
     {
       //if frame allocated is invalid, throw an exception
@@ -158,34 +455,351 @@ void BufMgr::flushFile(File& file) {
       {
         throw PagePinnedException(file.filename(), bufDescTable[i].pageNo, i);
       }
-      //when found, if page is dirty, write to disk and update dirty bit
-      if (bufDescTable[i].dirty != 0)
+      frames.push_back(i);
+    }
+  }
+
+  //write the dirty pages back as one checkpoint batch, without holding the
+  //pool latch, so that demand reads are not stuck behind it
+  std::vector<FrameId> writing;
+  std::vector<std::pair<File*, const Page*>> writes;
+  for (FrameId i : frames)
+  {
+    if (bufDescTable[i].dirty)
+    {
+      bufDescTable[i].writeInProgress = true;
+      bufDescTable[i].dirty = false;
+      numDirty--;
+      writing.push_back(i);
+      writes.emplace_back(&bufDescTable[i].file, &bufPool[i]);
+    }
+  }
+  std::exception_ptr error;
+  if (!writes.empty())
+  {
+    std::vector<std::exception_ptr> errors;
+    lock.unlock();
+    ioScheduler.writeAll(IoClass::CHECKPOINT, writes, errors);
+    lock.lock();
+    for (std::size_t k = 0; k < writing.size(); k++)
+    {
+      BufDesc& desc = bufDescTable[writing[k]];
+      desc.writeInProgress = false;
+      if (errors[k])
+      {
+        if (!desc.dirty)
+        {
+          desc.dirty = true;
+          numDirty++;
+        }
+        if (!error) error = errors[k];
+      }
+      else
+      {
+        bufStats.diskwrites++;
+      }
+    }
+    ioDone.notify_all();
+  }
+  if (error)
+  {
+    std::rethrow_exception(error);
+  }
+  return frames;
+}
+
+void BufMgr::flushFile(File& file) {
+  std::unique_lock<std::mutex> lock(poolMutex);
+  const std::vector<FrameId> frames = writeBackFile(lock, file);
+
+  //remove pages from bufferpool, leaving any that another thread reused,
+  //pinned or re-dirtied while the latch was released
+  for (FrameId i : frames)
+  {
+    BufDesc& desc = bufDescTable[i];
+    if (desc.valid && desc.file == file && desc.pinCnt == 0 && !desc.dirty)
+    {
+      hashTable.remove(file, desc.pageNo);
+      leaveWindow(i);
+      desc.clear();
+    }
+  }
+  if (compressedCache)
+  {
+    compressedCache->eraseFile(file.filename());
+  }
+  if (secondaryCache)
+  {
+    secondaryCache->eraseFile(file.filename());
+  }
+}
+
+void BufMgr::snapshotFile(File& file, const std::string& snapshotName) {
+  {
+    std::unique_lock<std::mutex> lock(poolMutex);
+    writeBackFile(lock, file);
+  }
+  //the written pages stay cached
+  file.snapshot(snapshotName);
+}
+
+void BufMgr::discardFile(File& file) {
+  std::unique_lock<std::mutex> lock(poolMutex);
+  waitForWriteBack(lock, [&file](const BufDesc& desc) {
+    return desc.file == file;
+  });
+  for (FrameId i = 0; i < numBufs; i++)
+  {
+    if (bufDescTable[i].file == file && bufDescTable[i].pinCnt != 0)
+    {
+      throw PagePinnedException(file.filename(), bufDescTable[i].pageNo, i);
+    }
+  }
+  std::vector<PageId> unwritten;
+  for (FrameId i = 0; i < numBufs; i++)
+  {
+    BufDesc& desc = bufDescTable[i];
+    if (desc.valid && desc.file == file)
+    {
+      if (desc.dirty)
       {
-        bufDescTable[i].file.writePage(bufPool[i]);
-        bufDescTable[i].dirty = 0;
+        numDirty--;
+        unwritten.push_back(desc.pageNo);
       }
-      //remove page from bufferpool
-      hashTable.remove(file, bufDescTable[i].pageNo);
-      bufDescTable[i].clear();
+      hashTable.remove(file, desc.pageNo);
+      leaveWindow(i);
+      desc.clear();
     }
   }
+  //deferred pages that are dropped must not be committed as empty pages by
+  //a later write; the latch is kept so that no such write can come first
+  if (!unwritten.empty() && !file.isTemporary())
+  {
+    ioScheduler.execute(IoClass::FOREGROUND, file, [&file, &unwritten]() {
+      for (PageId pageNo : unwritten) {
+        file.dropReservation(pageNo);
+      }
+    });
+  }
+  if (compressedCache)
+  {
+    compressedCache->eraseFile(file.filename());
+  }
+  if (secondaryCache)
+  {
+    secondaryCache->eraseFile(file.filename());
+  }
 }
 
 void BufMgr::disposePage(File& file, const PageId PageNo) { 
+    std::unique_lock<std::mutex> lock(poolMutex);
+    waitForWriteBack(lock, [&file, PageNo](const BufDesc& desc) {
+      return desc.file == file && desc.pageNo == PageNo;
+    });
     FrameId toDispose;
 
     try{
         hashTable.lookup(file, PageNo, toDispose);
+        if (bufDescTable[toDispose].dirty) {
+          numDirty--;
+        }
+        leaveWindow(toDispose);
         bufDescTable[toDispose].clear();
         hashTable.remove(file, PageNo);
     }
     catch(HashNotFoundException &e){}
+    if (compressedCache) {
+      compressedCache->erase(file.filename(), PageNo);
+    }
+    if (secondaryCache) {
+      secondaryCache->erase(file.filename(), PageNo);
+    }
 
     //delete page from the file
-    file.deletePage(PageNo);
+    ioScheduler.execute(IoClass::FOREGROUND, file,
+                        [&file, PageNo]() { file.deletePage(PageNo); });
+}
+
+void BufMgr::usedPages(File& file, std::vector<PageId>& pages) {
+  pages.clear();
+  ioScheduler.execute(IoClass::FOREGROUND, file, [&file, &pages]() {
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      pages.push_back(iter.page_number());
+    }
+  });
+}
+
+void BufMgr::enableSecondaryCache(const std::string& path,
+                                  const std::uint32_t capacityPages,
+                                  const std::uint32_t admitAfterHits,
+                                  const StorageOptions& options) {
+  std::shared_ptr<SecondaryCache> cache(
+      new SecondaryCache(path, capacityPages, admitAfterHits, options));
+  std::lock_guard<std::mutex> lock(poolMutex);
+  secondaryCache = cache;
+}
+
+void BufMgr::disableSecondaryCache() {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  secondaryCache.reset();
+}
+
+void BufMgr::enableCompressedCache(const std::size_t budgetBytes) {
+  std::shared_ptr<CompressedCache> cache(new CompressedCache(budgetBytes));
+  std::lock_guard<std::mutex> lock(poolMutex);
+  compressedCache = cache;
+}
+
+void BufMgr::disableCompressedCache() {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  compressedCache.reset();
+}
+
+void BufMgr::enableAdmissionFilter(const std::uint32_t windowPercent) {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  admissionSketch.reset(new FrequencySketch(numBufs));
+  windowFrames = std::min(std::max(numBufs * windowPercent / 100, 1u),
+                          numBufs - 1);
+}
+
+void BufMgr::disableAdmissionFilter() {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  for (FrameId frame : probationWindow) {
+    bufDescTable[frame].probationary = false;
+  }
+  probationWindow.clear();
+  admissionSketch.reset();
+  windowFrames = 0;
+}
+
+void BufMgr::setEvictionPolicy(const EvictionPolicy& policy) {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  evictionPolicy = policy;
+  evictionPolicy.candidateWindow = std::max(policy.candidateWindow, 1u);
+}
+
+void BufMgr::startBackgroundFlusher(const FlushPolicy& policy) {
+  stopBackgroundFlusher();
+  std::lock_guard<std::mutex> lock(poolMutex);
+  flushController.reset(new FlushController(policy));
+  flusherStop = false;
+  dirtiedSinceRound = 0;
+  flusherThread = std::thread(&BufMgr::flusherLoop, this);
+}
+
+void BufMgr::stopBackgroundFlusher() {
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (!flusherThread.joinable()) {
+      return;
+    }
+    flusherStop = true;
+  }
+  flusherWake.notify_all();
+  flusherThread.join();
+  std::lock_guard<std::mutex> lock(poolMutex);
+  flushController.reset();
+}
+
+void BufMgr::flusherLoop() {
+  std::unique_lock<std::mutex> lock(poolMutex);
+  auto roundStart = std::chrono::steady_clock::now();
+  while (!flusherStop) {
+    flusherWake.wait_for(lock, flushController->policy().interval);
+    if (flusherStop) {
+      break;
+    }
+    std::chrono::nanoseconds writeTime(0);
+    std::uint32_t written = 0;
+    const std::uint32_t wanted =
+        flushController->pagesToFlush(numDirty, numBufs);
+    if (wanted > 0) {
+      written = writeBackDirty(lock, wanted, writeTime);
+    }
+    const auto now = std::chrono::steady_clock::now();
+    flushController->recordRound(dirtiedSinceRound, written, writeTime,
+                                 now - roundStart);
+    dirtiedSinceRound = 0;
+    roundStart = now;
+  }
+}
+
+std::uint32_t BufMgr::writeBackDirty(std::unique_lock<std::mutex>& lock,
+                                     const std::uint32_t maxPages,
+                                     std::chrono::nanoseconds& writeTime) {
+  // Claim the frames under the pool latch. Clearing the dirty bit before the
+  // write means a page re-dirtied during the write stays dirty.
+  std::vector<FrameId> frames;
+  for (std::uint32_t scanned = 0;
+       scanned < numBufs && frames.size() < maxPages; scanned++) {
+    flushHand = (flushHand + 1) % numBufs;
+    BufDesc& desc = bufDescTable[flushHand];
+    if (desc.valid && desc.dirty && desc.pinCnt == 0 && !desc.ioInProgress &&
+        !desc.writeInProgress) {
+      desc.writeInProgress = true;
+      desc.dirty = false;
+      numDirty--;
+      frames.push_back(flushHand);
+    }
+  }
+  if (frames.empty()) {
+    return 0;
+  }
+  // Write in file and page order so neighbouring pages go out back to back.
+  std::sort(frames.begin(), frames.end(), [this](FrameId a, FrameId b) {
+    const BufDesc& x = bufDescTable[a];
+    const BufDesc& y = bufDescTable[b];
+    return x.file.filename() < y.file.filename() ||
+           (x.file == y.file && x.pageNo < y.pageNo);
+  });
+  lock.unlock();
+
+  // Only write frames whose latch is free right now: waiting for a latch
+  // while holding others could deadlock with a thread that holds one
+  // exclusively and is waiting for one of ours.
+  std::vector<FrameId> failed;
+  std::vector<FrameId> latched;
+  std::vector<std::pair<File*, const Page*>> writes;
+  for (FrameId frameNo : frames) {
+    if (bufDescTable[frameNo].latch.tryLockShared()) {
+      latched.push_back(frameNo);
+      writes.emplace_back(&bufDescTable[frameNo].file, &bufPool[frameNo]);
+    } else {
+      failed.push_back(frameNo);
+    }
+  }
+  std::vector<std::exception_ptr> errors;
+  const auto start = std::chrono::steady_clock::now();
+  if (!writes.empty()) {
+    ioScheduler.writeAll(IoClass::WRITE_BACK, writes, errors);
+  }
+  for (std::size_t k = 0; k < latched.size(); k++) {
+    bufDescTable[latched[k]].latch.unlockShared();
+    if (errors[k]) {
+      failed.push_back(latched[k]);
+    }
+  }
+  writeTime = std::chrono::steady_clock::now() - start;
+
+  lock.lock();
+  for (FrameId frameNo : frames) {
+    bufDescTable[frameNo].writeInProgress = false;
+  }
+  for (FrameId frameNo : failed) {
+    // Busy or failed pages stay dirty for a later round or eviction.
+    if (!bufDescTable[frameNo].dirty) {
+      bufDescTable[frameNo].dirty = true;
+      numDirty++;
+    }
+  }
+  const std::uint32_t written = frames.size() - failed.size();
+  bufStats.diskwrites += written;
+  ioDone.notify_all();
+  return written;
 }
 
 void BufMgr::printSelf(void) {
+  std::lock_guard<std::mutex> lock(poolMutex);
   int validFrames = 0;
 
   for (FrameId i = 0; i < numBufs; i++) {
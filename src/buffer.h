@@ -8,11 +8,22 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "bufHashTbl.h"
+#include "compressed_cache.h"
 #include "file.h"
+#include "flush_controller.h"
+#include "frequency_sketch.h"
+#include "io_scheduler.h"
+#include "latch.h"
+#include "secondary_cache.h"
 
 namespace badgerdb {
 
@@ -68,6 +79,40 @@ class BufDesc {
    */
   bool refbit;
 
+  /**
+   * Number of times the page was found in this frame since it was loaded
+   */
+  std::uint32_t hits;
+
+  /**
+   * True while the page is being read from disk into this frame. The frame is
+   * already in the hash table; other requesters of the page wait for the read
+   * to complete instead of issuing their own.
+   */
+  bool ioInProgress;
+
+  /**
+   * True while this frame is being written back by the background flusher,
+   * a checkpoint or an eviction, or copied into a cache tier on eviction. The
+   * frame is not pinned, and cannot be
+   * pinned, evicted, flushed or disposed until the write completes.
+   */
+  bool writeInProgress;
+
+  /**
+   * True while the page is in the admission filter's probationary window
+   * instead of the main clock. Set by BufMgr after allocation; Set() leaves
+   * it alone.
+   */
+  bool probationary;
+
+  /**
+   * Latch protecting the contents of the frame. Only threads holding a pin
+   * on the frame may acquire it, so the frame cannot be evicted while
+   * latched.
+   */
+  RWLatch latch;
+
   /**
    * Initialize buffer frame for a new user
    */
@@ -77,7 +122,11 @@ class BufDesc {
     pageNo = Page::INVALID_NUMBER;
     dirty = false;
     refbit = false;
+    hits = 0;
     valid = false;
+    ioInProgress = false;
+    writeInProgress = false;
+    probationary = false;
   }
 
   /**
@@ -95,6 +144,9 @@ class BufDesc {
     dirty = false;
     valid = true;
     refbit = true;
+    hits = 0;
+    ioInProgress = false;
+    writeInProgress = false;
   }
 
   void Print() {
@@ -107,7 +159,8 @@ class BufDesc {
     std::cout << "valid:" << valid << " ";
     std::cout << "pinCnt:" << pinCnt << " ";
     std::cout << "dirty:" << dirty << " ";
-    std::cout << "refbit:" << refbit << "\n";
+    std::cout << "refbit:" << refbit << " ";
+    std::cout << "ioInProgress:" << ioInProgress << "\n";
   }
 };
 
@@ -130,10 +183,15 @@ struct BufStats {
    */
   int diskwrites;
 
+  /**
+   * Number of misses served from a secondary cache tier instead of disk
+   */
+  int cachereads;
+
   /**
    * Clear all values
    */
-  void clear() { accesses = diskreads = diskwrites = 0; }
+  void clear() { accesses = diskreads = diskwrites = cachereads = 0; }
 
   /**
    * Constructor of BufStats class
@@ -141,9 +199,41 @@ struct BufStats {
   BufStats() { clear(); }
 };
 
+/**
+ * @brief Tuning knobs for victim selection.
+ *
+ * Evicting a dirty frame makes the miss wait for a write-back. The clock
+ * therefore examines a window of evictable frames and picks the cheapest,
+ * where a frame's cost is its position in the window plus, if it is dirty,
+ * the dirty penalty.
+ */
+struct EvictionPolicy {
+  /**
+   * Maximum number of evictable frames examined per eviction; 1 evicts the
+   * first one found, as the plain clock does.
+   */
+  std::uint32_t candidateWindow;
+
+  /**
+   * Cost of writing back a dirty victim, in window positions. With a penalty
+   * of at least candidateWindow, any clean frame in the window is preferred.
+   */
+  std::uint32_t dirtyPenalty;
+
+  /**
+   * Constructs the default policy.
+   */
+  EvictionPolicy() : candidateWindow(8), dirtyPenalty(8) {}
+};
+
 /**
  * @brief The central class which manages the buffer pool including frame
  * allocation and deallocation to pages in the file
+ *
+ * A BufMgr may be shared by several threads. The descriptor table, hash table
+ * and clock are guarded by a single pool latch that is never held across a
+ * page read or write, including the cache tiers, so hits proceed while misses
+ * wait on the disk.
  */
 class BufMgr {
  private:
@@ -173,20 +263,218 @@ class BufMgr {
    */
   BufStats bufStats;
 
+  /**
+   * Latch protecting bufDescTable, hashTable, clockHand and bufStats
+   */
+  std::mutex poolMutex;
+
+  /**
+   * Signalled whenever a frame finishes (or abandons) an in-progress read
+   */
+  std::condition_variable ioDone;
+
+  /**
+   * Carries out every file operation of the buffer manager, ordered by
+   * priority class. It never calls back into the buffer manager, so it may be
+   * used with or without poolMutex held.
+   */
+  IoScheduler ioScheduler;
+
+  /**
+   * Number of valid frames whose dirty bit is set
+   */
+  std::uint32_t numDirty;
+
+  /**
+   * Number of clean frames dirtied since the last background flush round
+   */
+  std::uint32_t dirtiedSinceRound;
+
+  /**
+   * Position of the background flusher's sweep over the buffer pool
+   */
+  FrameId flushHand;
+
+  /**
+   * Decides write-back intensity and write throttling; null while the
+   * background flusher is not running
+   */
+  std::unique_ptr<FlushController> flushController;
+
+  /**
+   * Flash cache of pages evicted from the pool; null if not enabled
+   */
+  std::shared_ptr<SecondaryCache> secondaryCache;
+
+  /**
+   * Compressed in-memory cache of pages evicted from the pool; checked before
+   * the secondary cache.  Null if not enabled
+   */
+  std::shared_ptr<CompressedCache> compressedCache;
+
+  /**
+   * Access frequencies used by the admission filter; null if not enabled
+   */
+  std::unique_ptr<FrequencySketch> admissionSketch;
+
+  /**
+   * Frames of the admission filter's probationary window, oldest first.
+   * Newly loaded pages enter here and compete with the clock's victim for a
+   * frame in the main pool when they leave it
+   */
+  std::deque<FrameId> probationWindow;
+
+  /**
+   * Number of frames in the probationary window
+   */
+  std::uint32_t windowFrames;
+
+  /**
+   * How victims are chosen among evictable frames
+   */
+  EvictionPolicy evictionPolicy;
+
+  /**
+   * Thread running flusherLoop()
+   */
+  std::thread flusherThread;
+
+  /**
+   * Set to ask the background flusher to exit
+   */
+  bool flusherStop;
+
+  /**
+   * Wakes the background flusher before its interval expires
+   */
+  std::condition_variable flusherWake;
+
   /**
    * Advance clock to next frame in the buffer pool
    */
   void advanceClock();
 
   /**
-   * Allocate a free frame.
+   * Allocate a free frame. Caller must hold poolMutex through lock, which is
+   * released while a dirty victim is written back.
    *
+   * @param lock   	Lock on poolMutex
    * @param frame   	Frame reference, frame ID of allocated frame returned
    * via this variable
    * @throws BufferExceededException If no such buffer is found which can be
    * allocated
    */
-  void allocBuf(FrameId& frame);
+  void allocBuf(std::unique_lock<std::mutex>& lock, FrameId& frame);
+
+  /**
+   * Writes out all dirty pages of the file, leaving them in the buffer
+   * pool. Caller must hold poolMutex through lock, which is released while
+   * the pages are written.
+   *
+   * @param lock   	Lock on poolMutex
+   * @param file   	File object
+   * @return Frames that held pages of the file
+   * @throws  PagePinnedException If any page of the file is pinned in the
+   * buffer pool
+   * @throws  BadBufferException If an invalid frame is assigned to the file
+   */
+  std::vector<FrameId> writeBackFile(std::unique_lock<std::mutex>& lock,
+                                     File& file);
+
+  /**
+   * Allocates a new, empty page, close to a related page unless
+   * hintPageNo is Page::INVALID_NUMBER, and assigns it a frame.
+   *
+   * @param file   	File object
+   * @param hintPageNo  Number of the related page, or Page::INVALID_NUMBER
+   * @param PageNo  Number assigned to the page, returned via this reference
+   * @param page  	The in-memory page, returned via this reference
+   * @param deferred  Whether to defer the allocation on disk; the hint is
+   * then ignored
+   */
+  void allocPage(File& file, const PageId hintPageNo, PageId& pageNo,
+                 Page*& page, const bool deferred);
+
+  /**
+   * Decides between the clock's victim and the oldest evictable page of the
+   * probationary window, evicting the page the frequency sketch considers
+   * less valuable. The window page is promoted to the main pool if it wins.
+   * Caller must hold poolMutex.
+   *
+   * @param haveVictim  Whether the clock found a victim
+   * @param victim      The clock's victim; the frame to evict is returned via
+   * this variable
+   * @return  False if neither the clock nor the window has an evictable frame
+   */
+  bool admitOrEvict(const bool haveVictim, FrameId& victim);
+
+  /**
+   * Puts a newly allocated frame at the end of the probationary window,
+   * promoting the oldest window pages to the main pool if the window is over
+   * its size. Caller must hold poolMutex.
+   *
+   * @param frame   Frame to add
+   */
+  void enterWindow(const FrameId frame);
+
+  /**
+   * Removes a frame from the probationary window if it is in it. Called before
+   * a frame is cleared. Caller must hold poolMutex.
+   *
+   * @param frame   Frame to remove
+   */
+  void leaveWindow(const FrameId frame);
+
+  /**
+   * Returns the frame holding the given page, which the caller must have
+   * pinned.
+   *
+   * @param file   	File object
+   * @param pageNo  Page number
+   * @return  Frame number of the page.
+   * @throws  HashNotFoundException If the page is not in the buffer pool
+   * @throws  PageNotPinnedException If the page is not pinned
+   */
+  FrameId pinnedFrame(File& file, const PageId pageNo);
+
+  /**
+   * Body of the background flusher thread. Every policy interval it asks the
+   * flush controller how many pages to write back and writes them.
+   */
+  void flusherLoop();
+
+  /**
+   * Writes back up to maxPages dirty, unpinned frames, continuing the sweep
+   * where the previous call stopped. The pool latch is released while the
+   * pages are written. Caller must hold poolMutex through lock.
+   *
+   * @param lock      Caller's lock on poolMutex
+   * @param maxPages  Maximum number of pages to write back
+   * @param writeTime Time spent writing is returned via this variable
+   * @return  Number of pages written back.
+   */
+  std::uint32_t writeBackDirty(std::unique_lock<std::mutex>& lock,
+                               const std::uint32_t maxPages,
+                               std::chrono::nanoseconds& writeTime);
+
+  /**
+   * Waits until no frame that satisfies the given predicate is being
+   * written back. Caller must hold poolMutex through lock.
+   *
+   * @param lock    Caller's lock on poolMutex
+   * @param frames  Predicate selecting the frames of interest
+   */
+  template <typename Pred>
+  void waitForWriteBack(std::unique_lock<std::mutex>& lock, Pred frames) {
+    ioDone.wait(lock, [this, &frames]() {
+      for (FrameId i = 0; i < numBufs; i++) {
+        if (bufDescTable[i].writeInProgress && frames(bufDescTable[i])) {
+          return false;
+        }
+      }
+      return true;
+    });
+  }
 
  public:
   /**
@@ -199,12 +487,39 @@ class BufMgr {
    */
   BufMgr(std::uint32_t bufs);
 
+  /**
+   * Destructor of BufMgr class. Stops the background flusher if it is
+   * running.
+   */
+  ~BufMgr();
+
+  /**
+   * Starts a background thread that writes dirty pages back to disk, scaling
+   * its intensity to keep the dirty fraction of the pool under the policy's
+   * target. While it runs, callers that dirty pages through unPinPage() are
+   * delayed once the dirty fraction exceeds the policy's throttle ratio.
+   * Restarts the flusher if it is already running.
+   *
+   * @param policy  Flushing policy
+   */
+  void startBackgroundFlusher(const FlushPolicy& policy = FlushPolicy());
+
+  /**
+   * Stops the background flusher, waiting for its current round to finish.
+   * Does nothing if it is not running.
+   */
+  void stopBackgroundFlusher();
+
   /**
    * Reads the given page from the file into a frame and returns the pointer to
    * page. If the requested page is already present in the buffer pool pointer
    * to that frame is returned otherwise a new frame is allocated from the
    * buffer pool for reading the page.
    *
+   * Concurrent misses on the same page are single-flighted: the first
+   * requester installs the frame in the hash table before reading, and later
+   * requesters wait for that read instead of loading the page a second time.
+   *
    * @param file   	File object
    * @param PageNo  Page number in the file to be read
    * @param page  	Reference to page pointer. Used to fetch the Page object
@@ -212,10 +527,53 @@ class BufMgr {
    */
   void readPage(File& file, const PageId pageNo, Page*& page);
 
+  /**
+   * Reads the given page like readPage() above and then latches its contents
+   * in the given mode. The latch is released by the unPinPage() overload that
+   * takes a LatchMode.
+   *
+   * @param file   	File object
+   * @param PageNo  Page number in the file to be read
+   * @param page  	Reference to page pointer
+   * @param mode    Mode in which to latch the page contents
+   */
+  void readPage(File& file, const PageId pageNo, Page*& page,
+                const LatchMode mode);
+
+  /**
+   * Latches the contents of a page the caller has already pinned, but only if
+   * the latch can be granted without waiting.
+   *
+   * @param file   	File object
+   * @param PageNo  Page number
+   * @param mode    Mode in which to latch the page contents
+   * @return  True if the latch was acquired.
+   * @throws  PageNotPinnedException If the page is not pinned
+   */
+  bool tryLatchPage(File& file, const PageId pageNo, const LatchMode mode);
+
+  /**
+   * Converts the caller's shared latch on a pinned page into an exclusive
+   * one. If other readers hold the latch, upgrading in place could deadlock
+   * with them, so the shared latch is released and the exclusive latch is
+   * acquired afresh; the page may have been modified in between.
+   *
+   * @param file   	File object
+   * @param PageNo  Page number
+   * @return  True if the latch was upgraded without being released, false if
+   * the caller must re-validate what it read under the shared latch.
+   * @throws  PageNotPinnedException If the page is not pinned
+   */
+  bool upgradeLatch(File& file, const PageId pageNo);
+
   /**
    * Unpin a page from memory since it is no longer required for it to remain in
    * memory.
    *
+   * While the background flusher runs, a caller that dirties a page may be
+   * briefly delayed if dirty pages are accumulating faster than they can be
+   * written back.
+   *
    * @param file   	File object
    * @param PageNo  Page number
    * @param dirty		True if the page to be unpinned needs to be
@@ -224,6 +582,19 @@ class BufMgr {
    */
   void unPinPage(File& file, const PageId pageNo, const bool dirty);
 
+  /**
+   * Releases the caller's latch on the page contents and then unpins it.
+   *
+   * @param file   	File object
+   * @param PageNo  Page number
+   * @param dirty		True if the page to be unpinned needs to be
+   * marked dirty
+   * @param mode    Mode in which the caller holds the page latch
+   * @throws  PageNotPinnedException If the page is not already pinned
+   */
+  void unPinPage(File& file, const PageId pageNo, const bool dirty,
+                 const LatchMode mode);
+
   /**
    * Allocates a new, empty page in the file and returns the Page object.
    * The newly allocated page is also assigned a frame in the buffer pool.
@@ -236,10 +607,43 @@ class BufMgr {
    */
   void allocPage(File& file, PageId& pageNo, Page*& page);
 
+  /**
+   * Allocates a new, empty page like allocPage(), optionally deferring the
+   * allocation on disk. A deferred page only reserves its number in the file
+   * and is installed dirty, so nothing is written until the page is evicted
+   * or flushed; the page is not visible to file iteration until then.
+   * Pages of temporary files are always allocated this way.
+   *
+   * @param file   	File object
+   * @param PageNo  Page number. The number assigned to the page in the file is
+   * returned via this reference.
+   * @param page  	Reference to page pointer. The newly allocated in-memory
+   * Page object is returned via this reference.
+   * @param deferred  Whether to defer the allocation on disk
+   */
+  void allocPage(File& file, PageId& pageNo, Page*& page, const bool deferred);
+
+  /**
+   * Allocates a new, empty page like allocPage(), placing it on disk close
+   * to a related page, e.g. the sibling of a split B-tree node or the
+   * previous page of a heap, so that scanning them reads sequentially.
+   *
+   * @see File::allocatePage(const PageId)
+   * @param file   	File object
+   * @param hintPageNo  Number of the related page
+   * @param PageNo  Page number. The number assigned to the page in the file is
+   * returned via this reference.
+   * @param page  	Reference to page pointer. The newly allocated in-memory
+   * Page object is returned via this reference.
+   */
+  void allocPage(File& file, const PageId hintPageNo, PageId& pageNo,
+                 Page*& page);
+
   /**
    * Writes out all dirty pages of the file to disk.
    * All the frames assigned to the file need to be unpinned from buffer pool
    * before this function can be successfully called. Otherwise Error returned.
+   * The file's pages are also dropped from any secondary cache tier.
    *
    * @param file   	File object
    * @throws  PagePinnedException If any page of the file is pinned in the
@@ -249,6 +653,32 @@ class BufMgr {
    */
   void flushFile(File& file);
 
+  /**
+   * Drops all pages of the file from the buffer pool and the secondary cache
+   * tiers without writing them, e.g. once a temporary file has been
+   * consumed. Dirty pages are lost, and deferred pages that were never
+   * written do not become part of the file.
+   *
+   * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the
+   * buffer pool
+   */
+  void discardFile(File& file);
+
+  /**
+   * Writes out all dirty pages of the file, then copies the file to a new
+   * file under another name, cloning it copy-on-write where the filesystem
+   * supports it.
+   *
+   * @see File::snapshot()
+   * @param file   	File object
+   * @param snapshotName  Name of the copy
+   * @throws  PagePinnedException If any page of the file is pinned in the
+   * buffer pool
+   * @throws  FileExistsException If a file with that name already exists
+   */
+  void snapshotFile(File& file, const std::string& snapshotName);
+
   /**
    * Delete page from file and also from buffer pool if present.
    * Since the page is entirely deleted from file, its unnecessary to see if the
@@ -259,6 +689,86 @@ class BufMgr {
    */
   void disposePage(File& file, const PageId PageNo);
 
+  /**
+   * Lists the used pages of a file in the order a FileIterator visits them.
+   * Only page headers are read, and the pages are not brought into the
+   * buffer pool.
+   *
+   * @param file   	File object
+   * @param pages   Page numbers are returned via this variable
+   */
+  void usedPages(File& file, std::vector<PageId>& pages);
+
+  /**
+   * Adds a second cache tier on fast local storage behind the buffer pool.
+   * Pages evicted from the pool that had at least admitAfterHits hits are
+   * copied into it, and misses check it before reading from the file. Replaces
+   * any secondary cache already enabled.
+   *
+   * @param path            Name of the cache file to create
+   * @param capacityPages   Number of pages the cache holds
+   * @param admitAfterHits  Hits an evicted page needs to be admitted
+   * @param options         Storage backend to keep the cache file on
+   */
+  void enableSecondaryCache(const std::string& path,
+                            const std::uint32_t capacityPages,
+                            const std::uint32_t admitAfterHits = 1,
+                            const StorageOptions& options = StorageOptions());
+
+  /**
+   * Removes the secondary cache tier and deletes its file.
+   */
+  void disableSecondaryCache();
+
+  /**
+   * Adds a compressed in-memory cache tier behind the buffer pool. Pages
+   * evicted from the pool are compressed into it (falling back to the
+   * secondary cache for pages that do not compress well), and misses check it
+   * before the secondary cache and the file. Replaces any compressed cache
+   * already enabled.
+   *
+   * @param budgetBytes   Memory to devote to compressed pages
+   */
+  void enableCompressedCache(const std::size_t budgetBytes);
+
+  /**
+   * Removes the compressed cache tier and frees its memory.
+   */
+  void disableCompressedCache();
+
+  /**
+   * Enables a TinyLFU admission filter. Newly loaded pages first occupy a
+   * small probationary window of frames; when they leave it, they only
+   * displace the clock's victim if they have been accessed more often
+   * recently, so pages touched once by a scan do not push hot pages out.
+   *
+   * @param windowPercent   Share of the pool used as probationary window
+   */
+  void enableAdmissionFilter(const std::uint32_t windowPercent = 1);
+
+  /**
+   * Disables the admission filter; window pages join the main pool.
+   */
+  void disableAdmissionFilter();
+
+  /**
+   * Sets how victims are chosen among evictable frames.
+   *
+   * @param policy  New policy
+   */
+  void setEvictionPolicy(const EvictionPolicy& policy);
+
+  /**
+   * Sets the admission limits of one class of the buffer manager's I/O, e.g.
+   * to rate-limit checkpoints or background write-back.
+   *
+   * @param ioClass Class to configure
+   * @param limits  New limits
+   */
+  void setIoLimits(const IoClass ioClass, const IoClassLimits& limits) {
+    ioScheduler.setLimits(ioClass, limits);
+  }
+
   /**
    * Print member variable values.
    */
@@ -0,0 +1,111 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "change_map.h"
+
+namespace badgerdb {
+
+ChangeMap::ChangeMap(const std::string &name, const StorageOptions &options,
+                     const bool create)
+    : name_(mapName(name)) {
+  // The bitmap is small; keep it in one piece without simulated latency.
+  options_.kind = options.kind;
+  if (!StorageBackend::exists(name_)) {
+    return;
+  }
+  if (create) {
+    StorageBackend::remove(name_);
+    return;
+  }
+  storage_ = StorageBackend::open(name_, options_, false /* create */);
+  bits_.resize(static_cast<std::size_t>(storage_->size()));
+  if (!bits_.empty()) {
+    storage_->read(0, reinterpret_cast<char *>(bits_.data()), bits_.size());
+  }
+}
+
+void ChangeMap::start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (storage_) {
+    return;
+  }
+  storage_ = StorageBackend::open(name_, options_, true /* create */);
+  bits_.clear();
+}
+
+bool ChangeMap::tracking() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<bool>(storage_);
+}
+
+void ChangeMap::mark(const PageId first_page_number, const std::size_t count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!storage_) {
+    return;
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    set(first_page_number + i);
+    if (!backed_up_.empty()) {
+      remarked_.insert(first_page_number + i);
+    }
+  }
+}
+
+std::vector<PageId> ChangeMap::beginBackup() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  backed_up_.clear();
+  remarked_.clear();
+  for (std::size_t byte = 0; byte < bits_.size(); ++byte) {
+    for (unsigned bit = 0; bits_[byte] != 0 && bit < 8; ++bit) {
+      if (bits_[byte] & (1u << bit)) {
+        backed_up_.push_back(static_cast<PageId>(byte * 8 + bit));
+      }
+    }
+  }
+  return backed_up_;
+}
+
+void ChangeMap::commitBackup() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!storage_ || backed_up_.empty()) {
+    return;
+  }
+  for (const PageId page_number : backed_up_) {
+    if (remarked_.count(page_number) == 0) {
+      bits_[page_number / 8] &= static_cast<std::uint8_t>(
+          ~(1u << (page_number % 8)));
+    }
+  }
+  backed_up_.clear();
+  remarked_.clear();
+  while (!bits_.empty() && bits_.back() == 0) {
+    bits_.pop_back();
+  }
+  // Each byte is either as before or has only committed pages cleared, so a
+  // crash part way through loses no change.
+  if (!bits_.empty()) {
+    storage_->write(0, reinterpret_cast<const char *>(bits_.data()),
+                    bits_.size());
+  }
+  storage_->truncate(bits_.size());
+}
+
+void ChangeMap::set(const PageId page_number) {
+  const std::size_t byte = static_cast<std::size_t>(page_number / 8);
+  const std::uint8_t bit = static_cast<std::uint8_t>(1u << (page_number % 8));
+  if (byte >= bits_.size()) {
+    bits_.resize(byte + 1);
+  }
+  if (bits_[byte] & bit) {
+    return;
+  }
+  bits_[byte] |= bit;
+  storage_->write(byte, reinterpret_cast<const char *>(&bits_[byte]), 1);
+}
+
+}  // namespace badgerdb
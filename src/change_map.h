@@ -0,0 +1,143 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "storage_backend.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Record of the pages of a file changed since the last backup.
+ *
+ * One bit per page, kept in memory and in a file of its own next to the
+ * file it tracks.  A page's byte of the bitmap is written only when one of
+ * its bits is first set, so a page written many times between backups costs
+ * one small write.  Tracking is off until start() is called, and stays on
+ * across reopening the file for as long as the bitmap file exists.
+ */
+class ChangeMap {
+ public:
+  /**
+   * Opens the bitmap of a file, if changes to it are tracked.
+   *
+   * @param name    Name of the tracked file.
+   * @param options Storage the tracked file is on.
+   * @param create  Whether the tracked file is being created, discarding any
+   *                bitmap left behind by an earlier file of the same name.
+   * @throws  IoException  If the bitmap exists but cannot be read.
+   */
+  ChangeMap(const std::string &name, const StorageOptions &options,
+            const bool create);
+
+  ChangeMap(const ChangeMap &) = delete;
+  ChangeMap &operator=(const ChangeMap &) = delete;
+
+  /**
+   * Returns the name of the bitmap of a file.
+   *
+   * @param name  Name of the tracked file.
+   */
+  static std::string mapName(const std::string &name) {
+    return name + ".changes";
+  }
+
+  /**
+   * Starts tracking changes with no page marked, creating the bitmap.  Does
+   * nothing if changes are already tracked.
+   *
+   * @throws  IoException  If the bitmap cannot be created.
+   */
+  void start();
+
+  /**
+   * Returns whether changes are tracked.
+   */
+  bool tracking();
+
+  /**
+   * Marks pages as changed.  Does nothing if changes are not tracked.
+   *
+   * @param first_page_number   Number of the first page.
+   * @param count               Number of consecutive pages.
+   */
+  void mark(const PageId first_page_number, const std::size_t count);
+
+  /**
+   * Starts a backup: returns the pages marked as changed, in ascending
+   * order, and notes which of them are marked again from now on.  Nothing
+   * is unmarked until commitBackup(), so a backup that is never committed,
+   * e.g. because the process crashed, is simply repeated by the next one.
+   *
+   * @return  Numbers of the pages.
+   */
+  std::vector<PageId> beginBackup();
+
+  /**
+   * Unmarks the pages returned by the last beginBackup(), except those
+   * changed since, and writes the bitmap.  Does nothing if no backup was
+   * begun since the last commit.
+   *
+   * @throws  IoException  If the bitmap cannot be written.
+   */
+  void commitBackup();
+
+ private:
+  /**
+   * Sets the bit of a page, writing its byte if it changed.  Caller must
+   * hold mutex_.
+   */
+  void set(const PageId page_number);
+
+  /**
+   * Name of the bitmap.
+   */
+  std::string name_;
+
+  /**
+   * Options to create the bitmap with.
+   */
+  StorageOptions options_;
+
+  /**
+   * Storage of the bitmap, or null if changes are not tracked.
+   */
+  std::shared_ptr<StorageBackend> storage_;
+
+  /**
+   * The bitmap; bit p % 8 of byte p / 8 is that of page p.
+   */
+  std::vector<std::uint8_t> bits_;
+
+  /**
+   * Pages returned by beginBackup() and not yet committed.
+   */
+  std::vector<PageId> backed_up_;
+
+  /**
+   * Pages marked since beginBackup(); kept in memory only, as the bitmap
+   * keeps them marked until the backup is committed.
+   */
+  std::set<PageId> remarked_;
+
+  /**
+   * Guards every member above.
+   */
+  std::mutex mutex_;
+};
+
+}  // namespace badgerdb
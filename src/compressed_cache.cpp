@@ -0,0 +1,130 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "compressed_cache.h"
+
+#include <cstring>
+#include <iterator>
+
+#include "page_codec.h"
+
+namespace badgerdb {
+
+const std::size_t CompressedCache::GRANULE;
+const std::size_t CompressedCache::NUM_CLASSES;
+const std::size_t CompressedCache::SLAB_SIZE;
+
+CompressedCache::CompressedCache(const std::size_t budgetBytes)
+    : num_slabs_(budgetBytes / SLAB_SIZE), used_slabs_(0) {
+  arena_.reset(new char[num_slabs_ * SLAB_SIZE]);
+}
+
+bool CompressedCache::insert(const std::string &filename, const Page &page) {
+  char image[Page::SIZE];
+  std::memcpy(image, &page.header_, sizeof(page.header_));
+  std::memcpy(image + sizeof(page.header_), page.data_.data(),
+              Page::DATA_SIZE);
+  char packed[Page::SIZE];
+  const std::size_t length =
+      PageCodec::compress(image, Page::SIZE, packed, Page::SIZE - GRANULE);
+  if (length == 0) {
+    return false;
+  }
+  const std::size_t size_class = (length - 1) / GRANULE;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Key key(filename, page.page_number());
+  Index::iterator existing = index_.find(key);
+  if (existing != index_.end()) {
+    drop(existing);
+  }
+  std::uint32_t offset;
+  if (!allocSlot(size_class, offset)) {
+    return false;
+  }
+  std::memcpy(&arena_[offset], packed, length);
+  ages_[size_class].push_back(key);
+  Entry entry = {offset, static_cast<std::uint16_t>(length),
+                 static_cast<std::uint8_t>(size_class),
+                 std::prev(ages_[size_class].end())};
+  index_.insert(std::make_pair(key, entry));
+  return true;
+}
+
+bool CompressedCache::take(const std::string &filename,
+                           const PageId page_number, Page &page) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Index::iterator entry = index_.find(Key(filename, page_number));
+  if (entry == index_.end()) {
+    return false;
+  }
+  char image[Page::SIZE];
+  const bool ok = PageCodec::decompress(&arena_[entry->second.offset],
+                                        entry->second.length, image,
+                                        Page::SIZE);
+  drop(entry);
+  if (!ok) {
+    return false;
+  }
+  std::memcpy(&page.header_, image, sizeof(page.header_));
+  page.data_.assign(image + sizeof(page.header_), Page::DATA_SIZE);
+  page.dirty_sectors_ = 0;
+  return true;
+}
+
+void CompressedCache::erase(const std::string &filename,
+                            const PageId page_number) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Index::iterator entry = index_.find(Key(filename, page_number));
+  if (entry != index_.end()) {
+    drop(entry);
+  }
+}
+
+void CompressedCache::eraseFile(const std::string &filename) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Index::iterator entry = index_.lower_bound(Key(filename, 0));
+  while (entry != index_.end() && entry->first.first == filename) {
+    drop(entry++);
+  }
+}
+
+std::uint32_t CompressedCache::size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return index_.size();
+}
+
+bool CompressedCache::allocSlot(const std::size_t size_class,
+                                std::uint32_t &offset) {
+  std::vector<std::uint32_t> &free_slots = free_slots_[size_class];
+  if (free_slots.empty() && used_slabs_ < num_slabs_) {
+    const std::size_t slot_size = (size_class + 1) * GRANULE;
+    const std::size_t base = used_slabs_++ * SLAB_SIZE;
+    for (std::size_t slot = 0; slot + slot_size <= SLAB_SIZE;
+         slot += slot_size) {
+      free_slots.push_back(static_cast<std::uint32_t>(base + slot));
+    }
+  }
+  if (free_slots.empty() && !ages_[size_class].empty()) {
+    drop(index_.find(ages_[size_class].front()));
+  }
+  if (free_slots.empty()) {
+    return false;
+  }
+  offset = free_slots.back();
+  free_slots.pop_back();
+  return true;
+}
+
+void CompressedCache::drop(Index::iterator entry) {
+  free_slots_[entry->second.size_class].push_back(entry->second.offset);
+  ages_[entry->second.size_class].erase(entry->second.age);
+  index_.erase(entry);
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,180 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief In-memory cache of compressed pages evicted from the buffer pool.
+ *
+ * Evicted pages are compressed with PageCodec and stored in a fixed-size
+ * arena carved into 64 KB slabs.  Each slab is dedicated to one size class
+ * (multiples of 512 bytes), so a compressed page wastes less than 512 bytes
+ * and no general-purpose allocation happens per page.  When a size class has
+ * no free slot and no slab is left, its oldest page is dropped.  Pages that
+ * do not compress below Page::SIZE - 512 bytes are not cached.  Slabs are
+ * never returned to the free pool, so the split between size classes follows
+ * the first pages admitted.
+ *
+ * Like SecondaryCache, the cache is exclusive with the buffer pool: a page is
+ * removed when it is read back into a frame.
+ */
+class CompressedCache {
+ public:
+  /**
+   * Allocates the arena.
+   *
+   * @param budgetBytes   Memory to devote to compressed pages; rounded down
+   *                      to whole slabs.
+   */
+  explicit CompressedCache(const std::size_t budgetBytes);
+
+  CompressedCache(const CompressedCache &) = delete;
+  CompressedCache &operator=(const CompressedCache &) = delete;
+
+  /**
+   * Compresses a page into the cache, replacing any cached copy of it.
+   *
+   * @param filename  Name of the file the page belongs to.
+   * @param page      Page to cache.
+   * @return  False if the page was not cached because it does not compress
+   *          well enough or its size class is out of room.
+   */
+  bool insert(const std::string &filename, const Page &page);
+
+  /**
+   * Removes a page from the cache and decompresses it.
+   *
+   * @param filename    Name of the file the page belongs to.
+   * @param page_number Number of the page.
+   * @param page        Page to decompress into.
+   * @return  True if the page was cached.
+   */
+  bool take(const std::string &filename, const PageId page_number,
+            Page &page);
+
+  /**
+   * Drops the cached copy of a page, if any.
+   *
+   * @param filename    Name of the file the page belongs to.
+   * @param page_number Number of the page.
+   */
+  void erase(const std::string &filename, const PageId page_number);
+
+  /**
+   * Drops every cached page of a file.
+   *
+   * @param filename  Name of the file.
+   */
+  void eraseFile(const std::string &filename);
+
+  /**
+   * Returns the number of pages currently cached.
+   */
+  std::uint32_t size();
+
+ private:
+  /**
+   * Granularity of the size classes.
+   */
+  static const std::size_t GRANULE = 512;
+
+  /**
+   * Number of size classes; class c holds pages compressed to at most
+   * (c + 1) * GRANULE bytes.  The last class would save nothing and is
+   * never used.
+   */
+  static const std::size_t NUM_CLASSES = Page::SIZE / GRANULE;
+
+  /**
+   * Size of a slab.
+   */
+  static const std::size_t SLAB_SIZE = 64 * 1024;
+
+  typedef std::pair<std::string, PageId> Key;
+
+  /**
+   * @brief Where a compressed page lives.
+   */
+  struct Entry {
+    std::uint32_t offset;
+    std::uint16_t length;
+    std::uint8_t size_class;
+    std::list<Key>::iterator age;
+  };
+
+  typedef std::map<Key, Entry> Index;
+
+  /**
+   * Returns the arena offset of a free slot of the given class, dedicating a
+   * new slab or dropping the class's oldest page if necessary.  Caller must
+   * hold mutex_.
+   *
+   * @param size_class  Size class.
+   * @param offset      Offset of the slot is returned via this variable.
+   * @return  False if the class is out of room.
+   */
+  bool allocSlot(const std::size_t size_class, std::uint32_t &offset);
+
+  /**
+   * Removes an index entry and frees its slot.  Caller must hold mutex_.
+   *
+   * @param entry   Index entry to remove.
+   */
+  void drop(Index::iterator entry);
+
+  /**
+   * Compressed pages.
+   */
+  std::unique_ptr<char[]> arena_;
+
+  /**
+   * Number of slabs in the arena.
+   */
+  std::size_t num_slabs_;
+
+  /**
+   * Number of slabs dedicated to a size class so far.
+   */
+  std::size_t used_slabs_;
+
+  /**
+   * Maps (file name, page number) to the page's slot.
+   */
+  Index index_;
+
+  /**
+   * Cached pages of each class, oldest first.
+   */
+  std::list<Key> ages_[NUM_CLASSES];
+
+  /**
+   * Free slots of each class.
+   */
+  std::vector<std::uint32_t> free_slots_[NUM_CLASSES];
+
+  /**
+   * Guards every member above.
+   */
+  std::mutex mutex_;
+};
+
+}  // namespace badgerdb
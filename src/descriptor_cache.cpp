@@ -0,0 +1,85 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "descriptor_cache.h"
+
+namespace badgerdb {
+
+DescriptorCache::DescriptorCache(const std::size_t capacity)
+    : capacity_(capacity) {}
+
+void DescriptorCache::insert(const std::string &name,
+                             const std::shared_ptr<StorageBackend> &storage,
+                             const StorageOptions &options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry &entry = entries_[name];
+  if (entry.storage && !entry.options.temporary) {
+    // The file was reopened before its previous state was released.
+    recent_.erase(entry.recent);
+  }
+  entry.options = options;
+  entry.storage = storage;
+  if (!options.temporary) {
+    recent_.push_front(name);
+    entry.recent = recent_.begin();
+    trim();
+  }
+}
+
+std::shared_ptr<StorageBackend> DescriptorCache::acquire(
+    const std::string &name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry &entry = entries_.at(name);
+  if (entry.options.temporary) {
+    return entry.storage;
+  }
+  if (entry.storage) {
+    recent_.splice(recent_.begin(), recent_, entry.recent);
+    return entry.storage;
+  }
+  entry.storage =
+      StorageBackend::open(name, entry.options, false /* create */);
+  recent_.push_front(name);
+  entry.recent = recent_.begin();
+  trim();
+  return entry.storage;
+}
+
+void DescriptorCache::erase(const std::string &name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unordered_map<std::string, Entry>::iterator entry = entries_.find(name);
+  if (entry == entries_.end()) {
+    return;
+  }
+  if (!entry->second.options.temporary && entry->second.storage) {
+    recent_.erase(entry->second.recent);
+  }
+  entries_.erase(entry);
+}
+
+void DescriptorCache::setCapacity(const std::size_t capacity) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  capacity_ = capacity;
+  trim();
+}
+
+std::size_t DescriptorCache::openCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return recent_.size();
+}
+
+void DescriptorCache::trim() {
+  // The most recently used storage is never closed, as its caller is about
+  // to use it.
+  while (recent_.size() > capacity_ && recent_.size() > 1) {
+    entries_.at(recent_.back()).storage.reset();
+    recent_.pop_back();
+  }
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,134 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "storage_backend.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Bounded cache of the open storage of opened files.
+ *
+ * Every opened file has an entry, but at most <capacity> of them keep their
+ * storage (and its file descriptors) open.  Beyond that, the least recently
+ * used storage is closed, and reopened with the same options the next time
+ * the file is accessed.  Storage a request is still using stays open until
+ * the request completes.
+ *
+ * Temporary storage cannot be reopened, so it is never closed and does not
+ * count against the capacity.
+ */
+class DescriptorCache {
+ public:
+  /**
+   * Constructs an empty cache.
+   *
+   * @param capacity  Number of files whose storage may be open at once.
+   */
+  explicit DescriptorCache(const std::size_t capacity);
+
+  DescriptorCache(const DescriptorCache &) = delete;
+  DescriptorCache &operator=(const DescriptorCache &) = delete;
+
+  /**
+   * Adds the storage of a newly opened file.
+   *
+   * @param name    Name of the file.
+   * @param storage Its open storage.
+   * @param options Options to reopen the storage with.
+   */
+  void insert(const std::string &name,
+              const std::shared_ptr<StorageBackend> &storage,
+              const StorageOptions &options);
+
+  /**
+   * Returns the storage of an opened file, reopening it if it was closed.
+   *
+   * @param name  Name of the file.
+   * @throws  IoException  If the storage cannot be reopened.
+   */
+  std::shared_ptr<StorageBackend> acquire(const std::string &name);
+
+  /**
+   * Forgets a file, closing its storage.
+   *
+   * @param name  Name of the file.
+   */
+  void erase(const std::string &name);
+
+  /**
+   * Changes the number of files whose storage may be open at once, closing
+   * storage if necessary.
+   *
+   * @param capacity  Number of files; at least 1.
+   */
+  void setCapacity(const std::size_t capacity);
+
+  /**
+   * Returns the number of files whose storage is open, not counting
+   * temporary files.
+   */
+  std::size_t openCount();
+
+ private:
+  /**
+   * @brief An opened file.
+   */
+  struct Entry {
+    /**
+     * Options to reopen the storage with.
+     */
+    StorageOptions options;
+
+    /**
+     * Open storage, or null if it was closed.
+     */
+    std::shared_ptr<StorageBackend> storage;
+
+    /**
+     * Position in recent_, if the storage is open and not temporary.
+     */
+    std::list<std::string>::iterator recent;
+  };
+
+  /**
+   * Closes the least recently used storage until at most capacity_ is open.
+   * Caller must hold mutex_.
+   */
+  void trim();
+
+  /**
+   * Opened files by name.
+   */
+  std::unordered_map<std::string, Entry> entries_;
+
+  /**
+   * Files whose storage can be closed and is open, most recently used first.
+   */
+  std::list<std::string> recent_;
+
+  /**
+   * Number of files whose storage may be open at once.
+   */
+  std::size_t capacity_;
+
+  /**
+   * Guards every member above.
+   */
+  std::mutex mutex_;
+};
+
+}  // namespace badgerdb
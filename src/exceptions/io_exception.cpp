@@ -0,0 +1,28 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "io_exception.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+IoException::IoException(const std::string &name, const std::string &operation,
+                         const int error)
+    : BadgerDbException(""), filename_(name), error_(error) {
+  std::stringstream ss;
+  ss << "I/O error during " << operation << " of file '" << filename_ << "'";
+  if (error_ != 0) {
+    ss << ": " << std::strerror(error_);
+  }
+  message_.assign(ss.str());
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,61 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the storage underneath a file
+ *        fails an I/O request.
+ */
+class IoException : public BadgerDbException {
+ public:
+  /**
+   * Constructs an I/O exception for the given file.
+   *
+   * @param name        Name of file the request was made to.
+   * @param operation   Operation that failed, e.g. "read".
+   * @param error       errno value describing the failure, or 0.
+   */
+  IoException(const std::string &name, const std::string &operation,
+              const int error);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~IoException() throw() {}
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string &filename() const { return filename_; }
+
+  /**
+   * Returns the errno value describing the failure, or 0.
+   */
+  virtual int error() const { return error_; }
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string filename_;
+
+  /**
+   * errno value describing the failure.
+   */
+  const int error_;
+};
+
+}  // namespace badgerdb
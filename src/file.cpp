@@ -8,181 +8,363 @@
 
 #include "file.h"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
 #include <cassert>
-#include <cstdio>
-#include <fstream>
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "change_map.h"
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
+#include "exceptions/io_exception.h"
 #include "file_iterator.h"
 #include "page.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
-File::CountMap File::open_counts_;
+DescriptorCache File::descriptors_(512);
+const std::size_t File::NUM_SHARDS;
+File::RegistryShard File::registry_[File::NUM_SHARDS];
+
+File File::create(const std::string &filename,
+                  const StorageOptions &options) {
+  return File(filename, true /* create_new */, options);
+}
 
-File File::create(const std::string &filename) {
-  return File(filename, true /* create_new */);
+File File::open(const std::string &filename, const StorageOptions &options) {
+  return File(filename, false /* create_new */, options);
 }
 
-File File::open(const std::string &filename) {
-  return File(filename, false /* create_new */);
+File File::createTemporary(const std::string &directory,
+                           const StorageOptions &options) {
+  // Workers create temporary files in parallel; each must get its own name.
+  static std::atomic<unsigned int> counter(0);
+  std::stringstream name;
+  name << directory << "/.badgerdb-temp-" << ::getpid() << "-" << ++counter;
+  StorageOptions temporary = options;
+  temporary.temporary = true;
+  return File(name.str(), true /* create_new */, temporary);
 }
 
-void File::remove(const std::string &filename) {
+void File::remove(const std::string &filename,
+                  const StorageOptions &options) {
   if (!exists(filename)) {
     throw FileNotFoundException(filename);
   }
   if (isOpen(filename)) {
     throw FileOpenException(filename);
   }
-  std::remove(filename.c_str());
+  StorageBackend::remove(filename, options);
+  if (StorageBackend::exists(ChangeMap::mapName(filename))) {
+    StorageBackend::remove(ChangeMap::mapName(filename));
+  }
 }
 
 bool File::isOpen(const std::string &filename) {
   if (!exists(filename)) {
     return false;
   }
-  return open_counts_.find(filename) != open_counts_.end();
+  RegistryShard &shard = shardFor(filename);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  RegistryShard::Map::const_iterator found = shard.files.find(filename);
+  return found != shard.files.end() && !found->second.file.expired();
 }
 
 bool File::exists(const std::string &filename) {
-  std::fstream file(filename);
-  if (file) {
-    file.close();
-    return true;
-  }
+  return StorageBackend::exists(filename);
+}
 
-  return false;
+void File::setMaxOpenStorage(const std::size_t max_open) {
+  descriptors_.setCapacity(max_open);
 }
 
+std::size_t File::openStorageCount() { return descriptors_.openCount(); }
+
 File::File(const File &other)
-    : filename_(other.filename_),
-      stream_(open_streams_[filename_]),
-      valid_(other.valid_) {
-  ++open_counts_[filename_];
-}
+    : filename_(other.filename_), open_(other.open_), valid_(other.valid_) {}
 
 File &File::operator=(const File &rhs) {
-  // This accounts for self-assignment and assignment of a File object for the
-  // same file.
-  close();  // close my file and associate me with the new one
+  // Sharing the state closes my file if I was its last object.
   filename_ = rhs.filename_;
+  open_ = rhs.open_;
   valid_ = rhs.valid_;
-  openIfNeeded(false /* create_new */);
   return *this;
 }
 
-File::~File() { close(); }
+File::File(File &&other) noexcept
+    : filename_(std::move(other.filename_)),
+      open_(std::move(other.open_)),
+      valid_(other.valid_) {
+  other.valid_ = false;
+}
 
-Page File::allocatePage() {
-  FileHeader header = readHeader();
-  Page new_page;
-  Page existing_page;
-  if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
-    new_page.set_page_number(header.first_free_page);
-    header.first_free_page = new_page.next_page_number();
-    --header.num_free_pages;
+File &File::operator=(File &&rhs) noexcept {
+  if (this != &rhs) {
+    filename_ = std::move(rhs.filename_);
+    open_ = std::move(rhs.open_);
+    valid_ = rhs.valid_;
+    rhs.valid_ = false;
+  }
+  return *this;
+}
 
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page
-      // later than the one we just allocated, so add the new page to the
-      // head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
-    } else {
-      // New page is reused from somewhere after the beginning, so we need
-      // to find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
-    }
+File::~File() {}
 
-    assert((header.num_free_pages == 0) ==
-           (header.first_free_page == Page::INVALID_NUMBER));
-  } else {
-    new_page.set_page_number(header.num_pages);
-    if (header.first_used_page == Page::INVALID_NUMBER) {
-      header.first_used_page = new_page.page_number();
-    } else {
-      // If we have pages allocated, we need to add the new page to the
-      // tail of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
-    }
-    ++header.num_pages;
+Page File::allocatePage() { return allocatePage(Page::INVALID_NUMBER); }
+
+Page File::allocatePage(const PageId near_page) {
+  TemporaryState *temporary = open_->temporary.get();
+  if (temporary) {
+    // Append without writing; the page reaches the storage when it is first
+    // written, with its header marked dirty so that it records the number.
+    Page new_page;
+    new_page.set_page_number(temporary->header.num_pages++);
+    new_page.markHeaderDirty();
+    return new_page;
   }
-  writePage(new_page.page_number(), new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
-    // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page);
+  FileHeader header = readHeader();
+  PageId page_number = Page::INVALID_NUMBER;
+  bool append = header.num_free_pages == 0;
+  if (near_page != Page::INVALID_NUMBER && !append) {
+    page_number = takeFreePageNear(header, near_page);
+    // Past the end of the file is better than a free page far away.
+    append = page_number == Page::INVALID_NUMBER &&
+             header.num_pages <= near_page + LOCALITY_EXTENT;
   }
-  writeHeader(header);
+  if (append) {
+    // Reserved pages keep their numbers; append past them.
+    const std::set<PageId> &reserved = open_->reservations;
+    extendFile(header,
+               reserved.empty()
+                   ? header.num_pages
+                   : std::max(header.num_pages, *reserved.rbegin() + 1));
+    page_number = header.num_pages++;
+  } else if (page_number == Page::INVALID_NUMBER) {
+    page_number = header.first_free_page;
+    header.first_free_page = readPageHeader(page_number).next_page_number;
+    --header.num_free_pages;
+  }
+  assert((header.num_free_pages == 0) ==
+         (header.first_free_page == Page::INVALID_NUMBER));
+  // Free pages hold nothing but their link, so the page is not read.
+  Page new_page;
+  new_page.set_page_number(page_number);
+  addUsedPage(header, new_page);
+  return new_page;
+}
 
+Page File::reservePage() {
+  const FileHeader header = readHeader();
+  if (header.num_free_pages > 0 || isTemporary()) {
+    return allocatePage();
+  }
+  std::set<PageId> &reserved = open_->reservations;
+  Page new_page;
+  new_page.set_page_number(
+      reserved.empty() ? header.num_pages
+                       : std::max(header.num_pages, *reserved.rbegin() + 1));
+  reserved.insert(new_page.page_number());
   return new_page;
 }
 
+void File::dropReservation(const PageId page_number) {
+  if (open_->reservations.erase(page_number) == 0) {
+    return;
+  }
+  // A reservation the file has grown past is a hole in it; free it.
+  FileHeader header = readHeader();
+  if (page_number < header.num_pages) {
+    Page free_page;
+    free_page.set_next_page_number(header.first_free_page);
+    writePage(page_number, free_page);
+    header.first_free_page = page_number;
+    ++header.num_free_pages;
+    writeHeader(header);
+  }
+}
+
 Page File::readPage(const PageId page_number) const {
+  return std::move(tryReadPage(page_number).valueOrThrow());
+}
+
+Result<Page> File::tryReadPage(const PageId page_number) const {
+  FileHeader header = readHeader();
+  if (page_number >= header.num_pages) {
+    return Error::invalidPage(page_number, open_->name);
+  }
+  Page page;
+  readPage(page_number, true /* allow_free */, page);
+  if (!page.isUsed()) {
+    return Error::invalidPage(page_number, open_->name);
+  }
+  return page;
+}
+
+void File::readPage(const PageId page_number, Page &page) const {
   FileHeader header = readHeader();
   if (page_number >= header.num_pages) {
     throw InvalidPageException(page_number, filename_);
   }
-  return readPage(page_number, false /* allow_free */);
+  readPage(page_number, false /* allow_free */, page);
 }
 
 Page File::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char *>(&page.header_), sizeof(page.header_));
-  stream_->read(&page.data_[0], Page::DATA_SIZE);
+  readPage(page_number, allow_free, page);
+  return page;
+}
+
+void File::readPage(const PageId page_number, const bool allow_free,
+                    Page &page) const {
+  // Page bodies always hold DATA_SIZE bytes, so this reuses the body's
+  // buffer.
+  page.data_.resize(Page::DATA_SIZE);
+  const IoBuffer buffers[] = {
+      {reinterpret_cast<char *>(&page.header_), sizeof(page.header_)},
+      {&page.data_[0], Page::DATA_SIZE}};
+  storage()->readv(pagePosition(page_number), buffers, 2);
+  page.dirty_sectors_ = 0;
+  const TemporaryState *temporary = open_->temporary.get();
+  if (temporary) {
+    if (temporary->deleted.count(page_number) > 0) {
+      page.initialize();
+    } else {
+      page.set_next_page_number(temporary->nextUsedPage(page_number));
+    }
+  }
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
-
-  return page;
 }
 
 void File::writePage(const Page &new_page) {
-  PageHeader header = readPageHeader(new_page.page_number());
-  if (header.current_page_number == Page::INVALID_NUMBER) {
-    // Page has been deleted since it was read.
-    throw InvalidPageException(new_page.page_number(), filename_);
+  const Page *pages[] = {&new_page};
+  writePages(pages, 1);
+}
+
+void File::readPages(const PageId first_page_number, const std::size_t count,
+                     Page *const *pages) const {
+  FileHeader header = readHeader();
+  if (first_page_number == Page::INVALID_NUMBER ||
+      first_page_number + count > header.num_pages) {
+    throw InvalidPageException(first_page_number, filename_);
+  }
+  std::string buffer(count * Page::SIZE, char());
+  storage()->read(pagePosition(first_page_number), &buffer[0], buffer.size());
+  const TemporaryState *temporary = open_->temporary.get();
+  for (std::size_t i = 0; i < count; ++i) {
+    Page &page = *pages[i];
+    const char *image = &buffer[i * Page::SIZE];
+    std::memcpy(&page.header_, image, sizeof(page.header_));
+    page.data_.assign(image + sizeof(page.header_), Page::DATA_SIZE);
+    page.dirty_sectors_ = 0;
+    if (temporary) {
+      if (temporary->deleted.count(first_page_number + i) > 0) {
+        throw InvalidPageException(first_page_number + i, filename_);
+      }
+      page.set_next_page_number(
+          temporary->nextUsedPage(first_page_number + i));
+    }
+    if (!page.isUsed()) {
+      throw InvalidPageException(first_page_number + i, filename_);
+    }
+  }
+}
+
+void File::writePages(const Page *const *pages, const std::size_t count) {
+  commitReservations(pages[0]->page_number(), pages[count - 1]->page_number());
+  const TemporaryState *temporary = open_->temporary.get();
+  std::string buffer(count * Page::SIZE, char());
+  for (std::size_t i = 0; i < count; ++i) {
+    const Page &new_page = *pages[i];
+    assert(new_page.page_number() == pages[0]->page_number() + i);
+    if (temporary) {
+      // Pages of temporary files carry no links, and may not have been
+      // written yet.
+      if (new_page.page_number() >= temporary->header.num_pages ||
+          temporary->deleted.count(new_page.page_number()) > 0) {
+        throw InvalidPageException(new_page.page_number(), filename_);
+      }
+      char *image = &buffer[i * Page::SIZE];
+      std::memcpy(image, &new_page.header_, sizeof(new_page.header_));
+      std::memcpy(image + sizeof(new_page.header_), new_page.data_.data(),
+                  Page::DATA_SIZE);
+      continue;
+    }
+    PageHeader header = readPageHeader(new_page.page_number());
+    if (header.current_page_number == Page::INVALID_NUMBER) {
+      // Page has been deleted since it was read.
+      throw InvalidPageException(new_page.page_number(), filename_);
+    }
+    // Page on disk may have had its next page pointer updated since it was
+    // read; we don't modify that, but we do keep all the other modifications
+    // to the page header.
+    const PageId next_page_number = header.next_page_number;
+    header = new_page.header_;
+    header.next_page_number = next_page_number;
+    char *image = &buffer[i * Page::SIZE];
+    std::memcpy(image, &header, sizeof(header));
+    std::memcpy(image + sizeof(header), new_page.data_.data(),
+                Page::DATA_SIZE);
+  }
+  // Only write runs of modified sectors; a run may continue into the next
+  // page.
+  const std::size_t sectors_per_page = Page::SIZE / Page::SECTOR_SIZE;
+  const std::size_t num_sectors = count * sectors_per_page;
+  const auto is_dirty = [pages, sectors_per_page](const std::size_t sector) {
+    return (pages[sector / sectors_per_page]->dirty_sectors_ >>
+            (sector % sectors_per_page)) & 1u;
+  };
+  std::size_t sector = 0;
+  while (sector < num_sectors) {
+    if (!is_dirty(sector)) {
+      ++sector;
+      continue;
+    }
+    std::size_t run_end = sector + 1;
+    while (run_end < num_sectors && is_dirty(run_end)) {
+      ++run_end;
+    }
+    storage()->write(
+        pagePosition(pages[0]->page_number()) + sector * Page::SECTOR_SIZE,
+        &buffer[sector * Page::SECTOR_SIZE],
+        (run_end - sector) * Page::SECTOR_SIZE);
+    markChanged(pages[0]->page_number() + sector / sectors_per_page,
+                (run_end - 1) / sectors_per_page - sector / sectors_per_page +
+                    1);
+    sector = run_end;
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    pages[i]->dirty_sectors_ = 0;
   }
-  // Page on disk may have had its next page pointer updated since it was read;
-  // we don't modify that, but we do keep all the other modifications to the
-  // page header.
-  const PageId next_page_number = header.next_page_number;
-  header = new_page.header_;
-  header.next_page_number = next_page_number;
-  writePage(new_page.page_number(), header, new_page);
 }
 
 void File::deletePage(const PageId page_number) {
+  TemporaryState *temporary = open_->temporary.get();
+  if (temporary) {
+    if (page_number == Page::INVALID_NUMBER ||
+        page_number >= temporary->header.num_pages ||
+        !temporary->deleted.insert(page_number).second) {
+      throw InvalidPageException(page_number, filename_);
+    }
+    // Pages of temporary files carry no links, so the whole page goes.
+    storage()->punchHole(pagePosition(page_number), Page::SIZE);
+    return;
+  }
+  if (open_->reservations.count(page_number) > 0) {
+    dropReservation(page_number);  // Never made it to disk.
+    return;
+  }
   FileHeader header = readHeader();
   Page existing_page = readPage(page_number);
   Page previous_page;
@@ -200,7 +382,8 @@ void File::deletePage(const PageId page_number) {
       }
     }
   }
-  // Clear the page and add it to the head of the free list.
+  // Clear the page and add it to the head of the free list.  Only the
+  // header is written; the body is released instead of overwritten.
   existing_page.initialize();
   existing_page.set_next_page_number(header.first_free_page);
   header.first_free_page = page_number;
@@ -208,8 +391,169 @@ void File::deletePage(const PageId page_number) {
   if (previous_page.isUsed()) {
     writePage(previous_page.page_number(), previous_page);
   }
-  writePage(page_number, existing_page);
+  writePageHeader(page_number, existing_page.header_);
+  storage()->punchHole(pagePosition(page_number) + sizeof(PageHeader),
+                       Page::DATA_SIZE);
+  markChanged(page_number, 1);
+  writeHeader(header);
+}
+
+void File::reclaimSpace() {
+  TemporaryState *temporary = open_->temporary.get();
+  if (temporary) {
+    FileHeader &header = temporary->header;
+    while (header.num_pages > 1 &&
+           temporary->deleted.erase(header.num_pages - 1) > 0) {
+      --header.num_pages;
+    }
+    storage()->truncate(pagePosition(header.num_pages));
+    return;
+  }
+  FileHeader header = readHeader();
+  std::map<PageId, PageHeader> free_pages;
+  for (PageId page_number = header.first_free_page;
+       page_number != Page::INVALID_NUMBER;
+       page_number = free_pages[page_number].next_page_number) {
+    free_pages[page_number] = readPageHeader(page_number);
+  }
+  truncateFreePages(header, free_pages);
+}
+
+std::map<PageId, PageId> File::compact() {
+  const std::vector<std::pair<PageId, PageHeader>> used = usedPages();
+  // The used list is in ascending order, so the pages past the first
+  // used.size() numbers are the ones that have to move, and the free pages
+  // among those numbers are where they go.
+  const PageId num_used = static_cast<PageId>(used.size());
+  std::vector<PageId> layout(num_used,
+                             static_cast<PageId>(Page::INVALID_NUMBER));
+  std::vector<PageId> moving;
+  for (const std::pair<PageId, PageHeader> &entry : used) {
+    if (entry.first <= num_used) {
+      layout[entry.first - 1] = entry.first;
+    } else {
+      moving.push_back(entry.first);
+    }
+  }
+  std::vector<PageId>::const_iterator next = moving.begin();
+  for (PageId &page_number : layout) {
+    if (page_number == Page::INVALID_NUMBER) {
+      page_number = *next++;
+    }
+  }
+  return relocatePages(used, layout);
+}
+
+std::map<PageId, PageId> File::reorganize() {
+  const std::vector<std::pair<PageId, PageHeader>> used = usedPages();
+  std::vector<PageId> layout;
+  layout.reserve(used.size());
+  for (const std::pair<PageId, PageHeader> &entry : used) {
+    layout.push_back(entry.first);
+  }
+  return relocatePages(used, layout);
+}
+
+void File::snapshot(const std::string &snapshot_name) {
+  if (isTemporary()) {
+    throw IoException(snapshot_name, "snapshot", EINVAL);
+  }
+  if (exists(snapshot_name)) {
+    throw FileExistsException(snapshot_name);
+  }
+  storage()->snapshot(snapshot_name);
+}
+
+void File::trackChanges() {
+  if (!open_->changes) {
+    throw IoException(filename_, "change tracking", EINVAL);
+  }
+  open_->changes->start();
+}
+
+std::uint64_t File::backupChanges(std::ostream &out) {
+  ChangeMap *changes = open_->changes.get();
+  if (!changes || !changes->tracking()) {
+    throw IoException(filename_, "backup", EINVAL);
+  }
+  // Pages stay marked until the caller commits the backup; pages written
+  // from now on stay marked after it.
+  std::vector<PageId> changed = changes->beginBackup();
+  const FileHeader header = readHeader();
+  // Pages past the end were cut off after they changed.
+  changed.erase(
+      std::lower_bound(changed.begin(), changed.end(), header.num_pages),
+      changed.end());
+  const std::uint64_t count = changed.size();
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+  std::vector<char> buffer;
+  std::size_t i = 0;
+  while (i < changed.size()) {
+    // Read each run of consecutive changed pages at once.
+    std::size_t run = 1;
+    while (i + run < changed.size() && run < BACKUP_RUN_PAGES &&
+           changed[i + run] == changed[i] + run) {
+      ++run;
+    }
+    buffer.resize(run * Page::SIZE);
+    storage()->read(pagePosition(changed[i]), buffer.data(), buffer.size());
+    for (std::size_t k = 0; k < run; ++k) {
+      out.write(reinterpret_cast<const char *>(&changed[i + k]),
+                sizeof(PageId));
+      out.write(&buffer[k * Page::SIZE], Page::SIZE);
+    }
+    i += run;
+  }
+  if (!out) {
+    throw IoException(filename_, "backup", EIO);
+  }
+  return count;
+}
+
+void File::commitBackup() {
+  if (open_->changes) {
+    open_->changes->commitBackup();
+  }
+}
+
+void File::applyChanges(std::istream &in) {
+  if (isTemporary()) {
+    throw IoException(filename_, "restore", EINVAL);
+  }
+  FileHeader header;
+  std::uint64_t count;
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+  in.read(reinterpret_cast<char *>(&count), sizeof(count));
+  std::vector<char> image(Page::SIZE);
+  for (std::uint64_t i = 0; in && i < count; ++i) {
+    PageId page_number;
+    in.read(reinterpret_cast<char *>(&page_number), sizeof(page_number));
+    in.read(image.data(), image.size());
+    if (in) {
+      storage()->write(pagePosition(page_number), image.data(), image.size());
+      markChanged(page_number, 1);
+    }
+  }
+  if (!in) {
+    throw IoException(filename_, "restore", EIO);
+  }
   writeHeader(header);
+  storage()->truncate(pagePosition(header.num_pages));
+}
+
+double File::fragmentation() const {
+  const std::vector<std::pair<PageId, PageHeader>> used = usedPages();
+  if (used.size() < 2) {
+    return 0.0;
+  }
+  std::size_t jumps = 0;
+  for (std::size_t i = 1; i < used.size(); ++i) {
+    if (used[i].first != used[i - 1].first + 1) {
+      ++jumps;
+    }
+  }
+  return static_cast<double>(jumps) / (used.size() - 1);
 }
 
 FileIterator File::begin() {
@@ -219,9 +563,10 @@ FileIterator File::begin() {
 
 FileIterator File::end() { return FileIterator(this, Page::INVALID_NUMBER); }
 
-File::File(const std::string &name, const bool create_new)
+File::File(const std::string &name, const bool create_new,
+           const StorageOptions &options)
     : filename_(name), valid_(true) {
-  openIfNeeded(create_new);
+  openIfNeeded(create_new, options);
 
   if (create_new) {
     // File starts with 1 page (the header).
@@ -231,42 +576,125 @@ File::File(const std::string &name, const bool create_new)
   }
 }
 
-void File::openIfNeeded(const bool create_new) {
-  if (open_counts_.find(filename_) !=
-      open_counts_.end()) {  // exists an entry already
-    ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+void File::openIfNeeded(const bool create_new,
+                        const StorageOptions &options) {
+  RegistryShard &shard = shardFor(filename_);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  RegistryShard::Map::iterator found = shard.files.find(filename_);
+  if (found != shard.files.end()) {
+    open_ = found->second.file.lock();
+    if (open_) {  // exists an entry already
+      return;
+    }
+  }
+  const bool already_exists = exists(filename_);
+  if (create_new) {
+    // Error if we try to overwrite an existing file.
+    if (already_exists) {
+      throw FileExistsException(filename_);
+    }
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
-    const bool already_exists = exists(filename_);
-    if (create_new) {
-      // Error if we try to overwrite an existing file.
-      if (already_exists) {
-        throw FileExistsException(filename_);
+    // Error if we try to open a file that doesn't exist.
+    if (!already_exists) {
+      valid_ = false;
+      throw FileNotFoundException(filename_);
+    }
+  }
+  // New files have to be truncated on open.
+  std::shared_ptr<StorageBackend> storage =
+      StorageBackend::open(filename_, options, create_new);
+  std::shared_ptr<OpenFile> opened = std::make_shared<OpenFile>(filename_);
+  if (options.temporary) {
+    // The header of a temporary file lives in memory only.
+    opened->temporary.reset(new TemporaryState());
+  } else {
+    opened->changes.reset(new ChangeMap(filename_, options, create_new));
+  }
+  descriptors_.insert(filename_, storage, options);
+  const Registration registration = {opened, opened.get()};
+  shard.files[filename_] = registration;
+  open_ = opened;
+}
+
+File::OpenFile::~OpenFile() {
+  RegistryShard &shard = shardFor(*name);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  RegistryShard::Map::iterator found = shard.files.find(*name);
+  // The file may have been opened again, under a new state, between the
+  // last object releasing this state and the state being destroyed.
+  if (found != shard.files.end() && found->second.state == this) {
+    descriptors_.erase(*name);
+    shard.files.erase(found);
+  }
+}
+
+File::RegistryShard &File::shardFor(const std::string &filename) {
+  return registry_[std::hash<std::string>()(filename) % NUM_SHARDS];
+}
+
+void File::commitReservations(const PageId first_page_number,
+                              const PageId last_page_number) {
+  std::set<PageId> &reserved = open_->reservations;
+  const std::vector<PageId> committed(
+      reserved.lower_bound(first_page_number),
+      reserved.upper_bound(last_page_number));
+  if (committed.empty()) {
+    return;
+  }
+  FileHeader header = readHeader();
+  extendFile(header, std::max(header.num_pages, last_page_number + 1));
+  // Link the pages into the used list in ascending order, walking the page
+  // headers only as far as the last of them.  Each committed page is
+  // written once its successor is known.
+  PageId previous = Page::INVALID_NUMBER;
+  PageHeader previous_header;
+  Page pending;
+  for (const PageId page_number : committed) {
+    reserved.erase(page_number);
+    PageId next = previous == Page::INVALID_NUMBER
+                      ? header.first_used_page
+                      : previous_header.next_page_number;
+    while (next != Page::INVALID_NUMBER && next < page_number) {
+      if (pending.isUsed()) {
+        writePage(pending.page_number(), pending);
+        pending = Page();
       }
-      // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
+      previous = next;
+      previous_header = readPageHeader(previous);
+      next = previous_header.next_page_number;
+    }
+    if (previous == Page::INVALID_NUMBER) {
+      header.first_used_page = page_number;
+    } else if (pending.isUsed()) {
+      pending.set_next_page_number(page_number);
+      writePage(pending.page_number(), pending);
     } else {
-      // Error if we try to open a file that doesn't exist.
-      if (!already_exists) {
-        valid_ = false;
-        throw FileNotFoundException(filename_);
-      }
+      previous_header.next_page_number = page_number;
+      writePageHeader(previous, previous_header);
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
-    open_counts_[filename_] = 1;
+    pending = Page();
+    pending.set_page_number(page_number);
+    pending.set_next_page_number(next);
+    previous = page_number;
+    previous_header = pending.header_;
   }
+  writePage(pending.page_number(), pending);
+  writeHeader(header);
 }
 
-void File::close() {
-  --open_counts_[filename_];
-  stream_.reset();
-  if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
-    open_counts_.erase(filename_);
+void File::extendFile(FileHeader &header, const PageId num_pages) {
+  for (PageId page_number = header.num_pages; page_number < num_pages;
+       ++page_number) {
+    if (open_->reservations.count(page_number) > 0) {
+      continue;  // Left as a hole until it is written or dropped.
+    }
+    Page free_page;
+    free_page.set_next_page_number(header.first_free_page);
+    writePage(page_number, free_page);
+    header.first_free_page = page_number;
+    ++header.num_free_pages;
   }
+  header.num_pages = std::max(header.num_pages, num_pages);
 }
 
 void File::writePage(const PageId page_number, const Page &new_page) {
@@ -275,32 +703,240 @@ void File::writePage(const PageId page_number, const Page &new_page) {
 
 void File::writePage(const PageId page_number, const PageHeader &header,
                      const Page &new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char *>(&header), sizeof(header));
-  stream_->write(&new_page.data_[0], Page::DATA_SIZE);
-  stream_->flush();
+  const ConstIoBuffer buffers[] = {
+      {reinterpret_cast<const char *>(&header), sizeof(header)},
+      {new_page.data_.data(), Page::DATA_SIZE}};
+  storage()->writev(pagePosition(page_number), buffers, 2);
+  markChanged(page_number, 1);
 }
 
 FileHeader File::readHeader() const {
+  const TemporaryState *temporary = open_->temporary.get();
+  if (temporary) {
+    FileHeader header = temporary->header;
+    header.first_used_page = temporary->nextUsedPage(Page::INVALID_NUMBER);
+    return header;
+  }
   FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char *>(&header), sizeof(header));
+  storage()->read(0 /* pos */, reinterpret_cast<char *>(&header),
+                 sizeof(header));
 
   return header;
 }
 
 void File::writeHeader(const FileHeader &header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char *>(&header), sizeof(header));
-  stream_->flush();
+  TemporaryState *temporary = open_->temporary.get();
+  if (temporary) {
+    temporary->header = header;
+    return;
+  }
+  storage()->write(0 /* pos */, reinterpret_cast<const char *>(&header),
+                  sizeof(header));
 }
 
 PageHeader File::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char *>(&header), sizeof(header));
+  storage()->read(pagePosition(page_number), reinterpret_cast<char *>(&header),
+                 sizeof(header));
+  const TemporaryState *temporary = open_->temporary.get();
+  if (temporary) {
+    header.next_page_number = temporary->nextUsedPage(page_number);
+  }
 
   return header;
 }
 
+void File::writePageHeader(const PageId page_number,
+                           const PageHeader &header) {
+  storage()->write(pagePosition(page_number),
+                   reinterpret_cast<const char *>(&header), sizeof(header));
+  markChanged(page_number, 1);
+}
+
+void File::markChanged(const PageId first_page_number,
+                       const std::size_t count) {
+  ChangeMap *changes = open_->changes.get();
+  if (changes) {
+    changes->mark(first_page_number, count);
+  }
+}
+
+PageId File::takeFreePageNear(FileHeader &header, const PageId near_page) {
+  PageId best = Page::INVALID_NUMBER;
+  PageId best_previous = Page::INVALID_NUMBER;
+  PageId best_next = Page::INVALID_NUMBER;
+  PageId best_distance = LOCALITY_EXTENT + 1;
+  PageId previous = Page::INVALID_NUMBER;
+  for (PageId page_number = header.first_free_page;
+       page_number != Page::INVALID_NUMBER && best_distance > 1;) {
+    const PageId next = readPageHeader(page_number).next_page_number;
+    const PageId distance = page_number > near_page
+                                ? page_number - near_page
+                                : near_page - page_number;
+    // On a tie, the page after the related one wins, as scans go forward.
+    if (distance < best_distance ||
+        (distance == best_distance && page_number > near_page)) {
+      best = page_number;
+      best_previous = previous;
+      best_next = next;
+      best_distance = distance;
+    }
+    previous = page_number;
+    page_number = next;
+  }
+  if (best == Page::INVALID_NUMBER) {
+    return best;
+  }
+  if (best_previous == Page::INVALID_NUMBER) {
+    header.first_free_page = best_next;
+  } else {
+    PageHeader previous_header = readPageHeader(best_previous);
+    previous_header.next_page_number = best_next;
+    writePageHeader(best_previous, previous_header);
+  }
+  --header.num_free_pages;
+  return best;
+}
+
+void File::addUsedPage(FileHeader &header, Page &new_page) {
+  const PageId page_number = new_page.page_number();
+  PageId previous = Page::INVALID_NUMBER;
+  PageHeader previous_header;
+  if (header.first_used_page == Page::INVALID_NUMBER ||
+      header.first_used_page > page_number) {
+    new_page.set_next_page_number(header.first_used_page);
+    header.first_used_page = page_number;
+  } else {
+    // Find the page to insert after by walking the headers of the list.
+    previous = header.first_used_page;
+    previous_header = readPageHeader(previous);
+    while (previous_header.next_page_number != Page::INVALID_NUMBER &&
+           previous_header.next_page_number < page_number) {
+      previous = previous_header.next_page_number;
+      previous_header = readPageHeader(previous);
+    }
+    new_page.set_next_page_number(previous_header.next_page_number);
+    previous_header.next_page_number = page_number;
+  }
+  writePage(page_number, new_page);
+  if (previous != Page::INVALID_NUMBER) {
+    writePageHeader(previous, previous_header);
+  }
+  writeHeader(header);
+}
+
+std::vector<std::pair<PageId, PageHeader>> File::usedPages() const {
+  const FileHeader header = readHeader();
+  std::vector<std::pair<PageId, PageHeader>> used;
+  for (PageId page_number = header.first_used_page;
+       page_number != Page::INVALID_NUMBER;
+       page_number = used.back().second.next_page_number) {
+    used.emplace_back(page_number, readPageHeader(page_number));
+  }
+  return used;
+}
+
+std::map<PageId, PageId> File::relocatePages(
+    const std::vector<std::pair<PageId, PageHeader>> &used,
+    const std::vector<PageId> &layout) {
+  const PageId num_used = static_cast<PageId>(layout.size());
+  std::map<PageId, PageId> moved;
+  for (PageId i = 0; i < num_used; ++i) {
+    if (layout[i] != i + 1) {
+      moved[layout[i]] = i + 1;
+    }
+  }
+  // A page whose new number still holds a page that has yet to move is
+  // read before being overwritten, and carried to its own new number next,
+  // so at most two pages are held at a time.  Pages of temporary files may
+  // not have been written yet.
+  TemporaryState *temporary = open_->temporary.get();
+  const bool allow_free = temporary != nullptr;
+  std::set<PageId> placed;
+  for (const std::pair<const PageId, PageId> &move : moved) {
+    if (placed.count(move.first) > 0) {
+      continue;
+    }
+    PageId source = move.first;
+    Page carried = readPage(source, allow_free);
+    placed.insert(source);
+    for (;;) {
+      const PageId destination = moved.at(source);
+      const bool displacing = moved.count(destination) > 0 &&
+                              placed.count(destination) == 0;
+      Page displaced;
+      if (displacing) {
+        readPage(destination, allow_free, displaced);
+      }
+      carried.set_page_number(destination);
+      carried.set_next_page_number(
+          destination < num_used ? destination + 1 : Page::INVALID_NUMBER);
+      writePage(destination, carried);
+      if (!displacing) {
+        break;
+      }
+      placed.insert(destination);
+      carried = std::move(displaced);
+      source = destination;
+    }
+  }
+  if (temporary) {
+    temporary->deleted.clear();
+    temporary->header.num_pages = num_used + 1;
+    storage()->truncate(pagePosition(num_used + 1));
+    return moved;
+  }
+  // Pages that stayed now link to the next number.
+  for (const std::pair<PageId, PageHeader> &entry : used) {
+    if (moved.count(entry.first) > 0) {
+      continue;
+    }
+    PageHeader page_header = entry.second;
+    const PageId next =
+        entry.first < num_used ? entry.first + 1 : Page::INVALID_NUMBER;
+    if (page_header.next_page_number != next) {
+      page_header.next_page_number = next;
+      writePageHeader(entry.first, page_header);
+    }
+  }
+  FileHeader header = readHeader();
+  header.num_pages = num_used + 1;
+  header.first_used_page = num_used > 0 ? 1 : Page::INVALID_NUMBER;
+  header.num_free_pages = 0;
+  header.first_free_page = Page::INVALID_NUMBER;
+  std::map<PageId, PageHeader> free_pages;
+  truncateFreePages(header, free_pages);
+  return moved;
+}
+
+void File::truncateFreePages(FileHeader &header,
+                             std::map<PageId, PageHeader> &free_pages) {
+  while (header.num_pages > 1 && free_pages.erase(header.num_pages - 1) > 0) {
+    --header.num_pages;
+  }
+  PageId next = Page::INVALID_NUMBER;
+  for (std::map<PageId, PageHeader>::reverse_iterator iter =
+           free_pages.rbegin();
+       iter != free_pages.rend(); ++iter) {
+    if (iter->second.next_page_number != next) {
+      iter->second.next_page_number = next;
+      writePageHeader(iter->first, iter->second);
+    }
+    next = iter->first;
+  }
+  header.first_free_page = next;
+  header.num_free_pages = static_cast<PageId>(free_pages.size());
+  writeHeader(header);
+  storage()->truncate(pagePosition(header.num_pages));
+}
+
+PageId File::TemporaryState::nextUsedPage(PageId page_number) const {
+  for (++page_number; page_number < header.num_pages; ++page_number) {
+    if (deleted.count(page_number) == 0) {
+      return page_number;
+    }
+  }
+  return Page::INVALID_NUMBER;
+}
+
 }  // namespace badgerdb
@@ -8,12 +8,22 @@
 
 #pragma once
 
-#include <fstream>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "change_map.h"
+#include "descriptor_cache.h"
 #include "page.h"
+#include "result.h"
+#include "storage_backend.h"
 
 namespace badgerdb {
 
@@ -60,16 +70,34 @@ struct FileHeader {
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
- * fixed-sized pages, and they never deallocate space (though they do reuse
- * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * The File class wraps the storage backend of an underlying file, chosen when
+ * the file is first opened (see StorageOptions).  Files contain fixed-sized
+ * pages.  Deleted pages go onto a free list for reuse, and their bodies are
+ * punched out of the storage where it supports holes.  reclaimSpace() cuts
+ * off the free pages at the end of the file, and compact() and reorganize()
+ * move used pages down into the free ones so that the file can be
+ * truncated.  If multiple File objects refer to the same underlying file,
+ * they will share the storage backend in memory.
  * If a file that has already been opened (possibly by another query), then the
- * File class detects this (by looking in the open_streams_ map) and just
- * returns a file object with the already created stream for the file without
- * actually opening the UNIX file again.
+ * File class detects this (by looking in the registry_ of opened files) and
+ * just returns a file object sharing the state of the opened file, without
+ * actually opening the UNIX file again.  File objects may be copied, assigned
+ * and destroyed from several threads at once; the state is reference counted
+ * and the registry is split into independently locked shards.
  *
- * @warning This class is not threadsafe.
+ * The storage of opened files is kept in a bounded DescriptorCache, so that
+ * a process can have many more files open than file descriptors: storage
+ * that has not been used recently is closed, and reopened on the next access
+ * to the file.
+ *
+ * Reading and writing pages (readPage(), readPages(), writePage() and
+ * writePages() on pages that already exist) may be done from several threads
+ * at once, through the same or different File objects: they go to the shared
+ * storage with positioned I/O.  Opening, copying and closing File objects is
+ * also safe concurrently, through the sharded registry.  Calls that change
+ * the file's layout (allocating, reserving and deleting pages, and the space
+ * reclamation calls) must not run concurrently with any other call on the
+ * same file; BufMgr ensures this through its I/O scheduler.
  */
 class File {
  public:
@@ -77,33 +105,55 @@ class File {
    * Creates a new file.
    *
    * @param filename  Name of the file.
+   * @param options   Storage to create the file on.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static File create(const std::string &filename);
+  static File create(const std::string &filename,
+                     const StorageOptions &options = StorageOptions());
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
    * It first checks if the file is already open. If so, then the new File
-   * object created uses the same input-output stream to read to or write fom
-   * that already open file. Reference count (open_counts_ static variable
-   * inside the File object) is incremented whenever an already open file is
-   * opened again. Otherwise the UNIX file is actually opened. The fileName and
-   * the stream associated with this File object are inserted into the
-   * open_streams_ map.
+   * object created uses the same storage backend to read to or write fom
+   * that already open file, sharing its reference-counted state; options are
+   * then ignored. Otherwise the UNIX file is actually opened. The fileName
+   * is registered in the registry_ of opened files and the storage is
+   * inserted into the descriptors_ cache.
    *
    * @param filename  Name of the file.
+   * @param options   Storage the file is on.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
-  static File open(const std::string &filename);
+  static File open(const std::string &filename,
+                   const StorageOptions &options = StorageOptions());
+
+  /**
+   * Creates a temporary file for intermediate results such as sort runs or
+   * hash partitions.  Its storage is anonymous (see StorageOptions::temporary)
+   * and disappears when the last File object for it is destroyed.  The file
+   * header is kept in memory only, pages are allocated by appending without
+   * writing anything, and deleted pages are not reused.  Allocated pages read
+   * as invalid until they are first written.
+   *
+   * @param directory Directory to create the storage in.
+   * @param options   Storage to create the file on; temporary is implied.
+   * @return  The file, under a generated unique name.
+   */
+  static File createTemporary(
+      const std::string &directory = ".",
+      const StorageOptions &options = StorageOptions());
 
   /**
    * Deletes an existing file.
    *
    * @param filename  Name of the file.
+   * @param options   Storage the file was created on; only its stripe
+   *                  directories and segment size matter.
    * @throws  FileNotFoundException   If the file doesn't exist.
    * @throws  FileOpenException       If the file is currently open.
    */
-  static void remove(const std::string &filename);
+  static void remove(const std::string &filename,
+                     const StorageOptions &options = StorageOptions());
 
   /**
    * Returns true if the file exists and is open.
@@ -119,6 +169,20 @@ class File {
    */
   static bool exists(const std::string &filename);
 
+  /**
+   * Sets how many opened files may keep their storage open at once (by
+   * default 512).  Temporary files do not count.
+   *
+   * @param max_open  Number of files; at least 1.
+   */
+  static void setMaxOpenStorage(const std::size_t max_open);
+
+  /**
+   * Returns the number of opened files whose storage is currently open, not
+   * counting temporary files.
+   */
+  static std::size_t openStorageCount();
+
   /**
    * Copy constructor.
    *
@@ -135,6 +199,22 @@ class File {
    */
   File &operator=(const File &rhs);
 
+  /**
+   * Move constructor.  Takes over the other object's reference to the file
+   * without touching the reference count; the other object becomes invalid.
+   *
+   * @param other File object to move from.
+   */
+  File(File &&other) noexcept;
+
+  /**
+   * Move assignment operator.  The other object becomes invalid.
+   *
+   * @param rhs File object to move from.
+   * @return    This file object.
+   */
+  File &operator=(File &&rhs) noexcept;
+
   /**
    * Check if two files are equal.
    * @param rhs File object to compare.
@@ -162,6 +242,48 @@ class File {
    */
   Page allocatePage();
 
+  /**
+   * Allocates a new page in the file close to a related page, so that
+   * scanning them in order reads the disk sequentially.  Takes the free page
+   * nearest to <near_page> within LOCALITY_EXTENT pages of it, or the next
+   * page past the end of the file if that is close enough; otherwise
+   * allocates like allocatePage().  Finding the nearest free page reads the
+   * header of every free page.
+   *
+   * @param near_page   Number of the related page.
+   * @return The new page.
+   */
+  Page allocatePage(const PageId near_page);
+
+  /**
+   * Distance in pages within which a page counts as close to a related
+   * page: 64 pages of 8 KB.
+   */
+  static const PageId LOCALITY_EXTENT = 64;
+
+  /**
+   * Reserves the number of a new page without writing anything to disk.  The
+   * page becomes part of the file when it is first written with writePage()
+   * or writePages(); other reservations are unaffected, and pages appended
+   * by allocatePage() meanwhile take numbers past every reservation.  Until
+   * then, the page cannot be read and file iteration does not visit it.
+   * Reservations are dropped when the last File object for the file is
+   * destroyed.  If the file has free pages, one of them is allocated with
+   * allocatePage() instead.
+   *
+   * @return The new page.
+   */
+  Page reservePage();
+
+  /**
+   * Gives up the reservation of a page returned by reservePage() that was
+   * never written.  If the file has since grown past the page, the page is
+   * added to the free list.  Does nothing if the page is not reserved.
+   *
+   * @param page_number   Number of the reserved page.
+   */
+  void dropReservation(const PageId page_number);
+
   /**
    * Reads an existing page from the file.
    *
@@ -172,9 +294,33 @@ class File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file into a Page object, reusing its
+   * storage instead of allocating a new page body.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page &page) const;
+
+  /**
+   * Reads an existing page from the file like readPage(), but reports a page
+   * that doesn't exist or is not currently used as an INVALID_PAGE error
+   * instead of throwing.  I/O failures still throw.  The error refers to the
+   * file's name, so it must not outlive the file's File objects.
+   *
+   * @param page_number   Number of page to read.
+   * @return  The page, or the error.
+   */
+  Result<Page> tryReadPage(const PageId page_number) const;
+
   /**
    * Writes a page into the file, replacing any existing contents.  The page
    * must have been already allocated in this file by a call to allocatePage().
+   * Only the sectors the page reports as dirty are transferred, since the
+   * rest still match the file; the page's dirty sectors are then cleared.
    *
    * @see allocatePage()
    * @param new_page  Page to write.
@@ -182,12 +328,140 @@ class File {
   void writePage(const Page &new_page);
 
   /**
-   * Deletes a page from the file.
+   * Reads consecutive pages from the file with a single read from disk.
+   *
+   * @param first_page_number   Number of first page to read.
+   * @param count               Number of pages to read.
+   * @param pages               Pages to read into; pages[i] receives page
+   *                            first_page_number + i.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  void readPages(const PageId first_page_number, const std::size_t count,
+                 Page *const *pages) const;
+
+  /**
+   * Writes consecutive pages into the file with a single write to disk,
+   * replacing their existing contents.  Each page must have been already
+   * allocated in this file, and pages[i + 1] must follow pages[i].  As with
+   * writePage(), only dirty sectors are transferred, with adjacent dirty
+   * sectors of neighbouring pages combined into one write.
+   *
+   * @param pages   Pages to write.
+   * @param count   Number of pages to write.
+   * @throws  InvalidPageException  If any of the pages has been deleted.
+   */
+  void writePages(const Page *const *pages, const std::size_t count);
+
+  /**
+   * Deletes a page from the file.  The page's body is punched out of the
+   * storage, so its space is released where the storage supports it; the
+   * page header stays to link the page into the free list.
    *
    * @param page_number   Number of page to delete.
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Shrinks the file by cutting off the free pages at its end, and relinks
+   * the remaining free pages in ascending order so that allocation reuses
+   * the lowest numbered ones first.
+   */
+  void reclaimSpace();
+
+  /**
+   * Moves the used pages at the end of the file into the free pages before
+   * them, so that the used pages are numbered 1 to N, and truncates the
+   * file after them.  Moved pages keep their contents; the caller must
+   * update any record IDs that refer to them.
+   *
+   * No buffer manager may hold pages of the file, as they would be cached
+   * under their old numbers: flush and discard the file first.
+   *
+   * @return  New page number of every moved page, by old number.
+   */
+  std::map<PageId, PageId> compact();
+
+  /**
+   * Rewrites the file so that its used pages are numbered 1 to N in the
+   * order the used list visits them, making a full scan read the file
+   * sequentially, and truncates the file after them.  As with compact(),
+   * the caller must update record IDs and no buffer manager may hold pages
+   * of the file.
+   *
+   * @return  New page number of every moved page, by old number.
+   */
+  std::map<PageId, PageId> reorganize();
+
+  /**
+   * Copies the file to a new file under another name, to be opened with the
+   * same storage options.  The copy is a copy-on-write clone where the
+   * filesystem supports it, so it takes time proportional to the file's
+   * metadata rather than its size.  Pages held dirty by a buffer manager are
+   * not included; use BufMgr::snapshotFile() to write them first.
+   *
+   * @param snapshot_name  Name of the copy.
+   * @throws  FileExistsException  If a file with that name already exists.
+   * @throws  IoException  If this is a temporary file, whose header is
+   *                       not stored, or the copy cannot be made.
+   */
+  void snapshot(const std::string &snapshot_name);
+
+  /**
+   * Starts recording which pages are written, in a bitmap stored next to the
+   * file, so that backupChanges() can copy only those.  Recording continues
+   * across reopening the file until it is removed.
+   *
+   * @throws  IoException  If this is a temporary file or the bitmap cannot
+   *                       be created.
+   */
+  void trackChanges();
+
+  /**
+   * Writes the pages changed since trackChanges() or the last committed
+   * backup to <out>, in ascending page order, reading runs of consecutive
+   * pages at once.  The stream holds the file header, the page count, and
+   * then the number and image of each page.  The pages stay marked as
+   * changed until commitBackup() is called, so a backup that is lost before
+   * then is repeated in full by the next one.
+   *
+   * @param out  Stream to write the changes to.
+   * @return  Number of pages written.
+   * @throws  IoException  If changes are not tracked or cannot be written.
+   */
+  std::uint64_t backupChanges(std::ostream &out);
+
+  /**
+   * Unmarks the pages written by the last backupChanges(), once the caller
+   * has made the backup durable.  Pages written since that call stay
+   * marked for the next backup.
+   *
+   * @throws  IoException  If the bitmap cannot be written.
+   */
+  void commitBackup();
+
+  /**
+   * Applies changes written by backupChanges() to a copy of the file as it
+   * was when they started, such as a snapshot or an earlier restore.
+   *
+   * @param in  Stream to read the changes from.
+   * @throws  IoException  If this is a temporary file or the stream ends
+   *                       early.
+   */
+  void applyChanges(std::istream &in);
+
+  /**
+   * Largest number of pages backupChanges() reads at once.
+   */
+  static const std::size_t BACKUP_RUN_PAGES = 128;
+
+  /**
+   * Returns the fraction of steps along the used list that do not go to the
+   * physically next page, from 0 when a full scan reads the file
+   * sequentially to 1 when every step jumps.
+   */
+  double fragmentation() const;
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -195,6 +469,13 @@ class File {
    */
   const std::string &filename() const { return filename_; }
 
+  /**
+   * Returns whether this is a temporary file.
+   *
+   * @see createTemporary()
+   */
+  bool isTemporary() const { return open_ && open_->temporary; }
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -235,12 +516,14 @@ class File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param options     Storage the file is on.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  explicit File(const std::string &name, const bool create_new);
+  File(const std::string &name, const bool create_new,
+       const StorageOptions &options);
 
   /**
    * Returns the position of the page with the given number in the file (as an
@@ -249,36 +532,32 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+  static std::uint64_t pagePosition(const PageId page_number) {
+    return sizeof(FileHeader) +
+           (static_cast<std::uint64_t>(page_number) - 1) * Page::SIZE;
   }
 
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing storage.
    *
    * @param create_new  Whether to create a new file.
+   * @param options     Storage the file is on, if it is not open yet.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  void openIfNeeded(const bool create_new);
-
-  /**
-   * Closes the underlying file stream in <stream_>.
-   * This method only closes the file if no other File objects exist that access
-   * the same file.
-   */
-  void close();
+  void openIfNeeded(const bool create_new,
+                    const StorageOptions &options = StorageOptions());
 
   /**
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file reads
+   * as a free page.
    *
    * @param page_number   Number of page to read.
    * @param allow_free    Whether to allow reading a free (unused) page.
@@ -288,6 +567,18 @@ class File {
    */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
+  /**
+   * Reads a page like readPage() above, into an existing Page object.
+   *
+   * @param page_number   Number of page to read.
+   * @param allow_free    Whether to allow reading a free (unused) page.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page is free (unused) and
+   *                                allow_free is false.
+   */
+  void readPage(const PageId page_number, const bool allow_free,
+                Page &page) const;
+
   /**
    * Writes a page into the file at the given page number.  This does not
    * update ensure that the number in the header equals the position on disk.
@@ -324,6 +615,28 @@ class File {
    */
   void writeHeader(const FileHeader &header);
 
+  /**
+   * Adds the reserved pages numbered first_page_number to last_page_number
+   * to the file as blank used pages, linked into the used list in order.
+   * Other reservations stay reserved.  Does nothing if no such page is
+   * reserved.
+   *
+   * @param first_page_number   Number of the first page to add.
+   * @param last_page_number    Number of the last page to add.
+   */
+  void commitReservations(const PageId first_page_number,
+                          const PageId last_page_number);
+
+  /**
+   * Grows the file to num_pages pages.  Reserved pages among the new numbers
+   * are left unwritten, as holes that read as unused pages, and the others
+   * are added to the free list.  The file header is not written.
+   *
+   * @param header      File header, updated for the growth.
+   * @param num_pages   New value of the header's num_pages.
+   */
+  void extendFile(FileHeader &header, const PageId num_pages);
+
   /**
    * Reads only the header of the given page from disk (not the record data
    * or slot table).  No bounds checking is performed.
@@ -333,18 +646,192 @@ class File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream>> StreamMap;
-  typedef std::map<std::string, int> CountMap;
+  /**
+   * Writes only the header of the given page to disk.  No bounds checking
+   * is performed.
+   *
+   * @param page_number   Number of page whose header is to be written.
+   * @param header        Header to write.
+   */
+  void writePageHeader(const PageId page_number, const PageHeader &header);
+
+  /**
+   * Marks pages just written as changed, if changes are tracked.
+   *
+   * @param first_page_number   Number of the first page written.
+   * @param count               Number of consecutive pages written.
+   */
+  void markChanged(const PageId first_page_number, const std::size_t count);
+
+  /**
+   * Removes the free page nearest to <near_page> within LOCALITY_EXTENT
+   * pages of it from the free list.
+   *
+   * @param header      File header, updated for the removal.
+   * @param near_page   Number of the related page.
+   * @return  Number of the removed page, or Page::INVALID_NUMBER if no free
+   *          page is close enough.
+   */
+  PageId takeFreePageNear(FileHeader &header, const PageId near_page);
+
+  /**
+   * Links a newly allocated page into the used list, keeping the list in
+   * ascending order, and writes the page, the page before it and the file
+   * header.
+   *
+   * @param header    File header, with the page already taken from the free
+   *                  list or counted in num_pages.
+   * @param new_page  Page to add; its next page number is set.
+   */
+  void addUsedPage(FileHeader &header, Page &new_page);
+
+  /**
+   * Returns the number and header of every used page, in the order of the
+   * used list.
+   */
+  std::vector<std::pair<PageId, PageHeader>> usedPages() const;
+
+  /**
+   * Moves used pages to new numbers so that they are numbered 1 to N with
+   * the used list in that order, then truncates the file after them.
+   *
+   * @param used    Number and header of every used page, as returned by
+   *                usedPages().
+   * @param layout  Old number of the page to place at each new number;
+   *                layout[i] goes to number i + 1.
+   * @return  New page number of every moved page, by old number.
+   */
+  std::map<PageId, PageId> relocatePages(
+      const std::vector<std::pair<PageId, PageHeader>> &used,
+      const std::vector<PageId> &layout);
+
+  /**
+   * Cuts off the free pages at the end of the file, relinks the remaining
+   * free pages in ascending order and writes the file header.
+   *
+   * @param header      File header, with num_pages set past the last used
+   *                    page or a free page.
+   * @param free_pages  Headers of the free pages, by number.
+   */
+  void truncateFreePages(FileHeader &header,
+                         std::map<PageId, PageHeader> &free_pages);
+
+  /**
+   * @brief In-memory state of a temporary file.
+   */
+  struct TemporaryState {
+    /**
+     * File header; first_used_page is derived from deleted.
+     */
+    FileHeader header;
+
+    /**
+     * Pages deleted since they were allocated.
+     */
+    std::set<PageId> deleted;
+
+    /**
+     * Returns the first used page after the given one, or
+     * Page::INVALID_NUMBER.  Used pages are linked in page number order
+     * without storing links in the pages.
+     */
+    PageId nextUsedPage(PageId page_number) const;
+  };
+
+  /**
+   * @brief State shared by every File object of an opened file.  The file is
+   * closed when the last of them releases it.
+   */
+  struct OpenFile {
+    explicit OpenFile(const std::string &filename)
+        : name(std::make_shared<const std::string>(filename)) {}
+
+    /**
+     * Removes the file from the registry and closes its storage.
+     */
+    ~OpenFile();
+
+    /**
+     * Name of the file, shared with the errors that report it.
+     */
+    std::shared_ptr<const std::string> name;
+
+    /**
+     * Reserved pages.  Those below the file's num_pages are holes left by
+     * pages appended after them.
+     */
+    std::set<PageId> reservations;
+
+    /**
+     * In-memory state, if this is a temporary file.
+     */
+    std::unique_ptr<TemporaryState> temporary;
+
+    /**
+     * Pages changed since the last backup; null if this is a temporary file.
+     */
+    std::unique_ptr<ChangeMap> changes;
+  };
+
+  /**
+   * @brief Entry of the registry of opened files.
+   */
+  struct Registration {
+    /**
+     * State of the file; expired once every File object released it.
+     */
+    std::weak_ptr<OpenFile> file;
+
+    /**
+     * Address of the state, to tell it from a newer state of the same file.
+     */
+    const OpenFile *state;
+  };
+
+  /**
+   * @brief One shard of the registry of opened files.
+   */
+  struct RegistryShard {
+    typedef std::map<std::string, Registration> Map;
+
+    /**
+     * Guards files.
+     */
+    std::mutex mutex;
+
+    /**
+     * Opened files whose names hash to this shard.
+     */
+    Map files;
+  };
+
+  /**
+   * Number of shards of the registry.
+   */
+  static const std::size_t NUM_SHARDS = 16;
+
+  /**
+   * Returns the registry shard of a file name.
+   */
+  static RegistryShard &shardFor(const std::string &filename);
+
+  /**
+   * Returns the storage of this file, reopening it if it was closed.
+   */
+  std::shared_ptr<StorageBackend> storage() const {
+    return descriptors_.acquire(filename_);
+  }
 
   /**
-   * Streams for opened files.
+   * Storage of opened files.
    */
-  static StreamMap open_streams_;
+  static DescriptorCache descriptors_;
 
   /**
-   * Counts for opened files.
+   * Registry of opened files, sharded by name so that opening different
+   * files does not contend on one lock.
    */
-  static CountMap open_counts_;
+  static RegistryShard registry_[NUM_SHARDS];
 
   /**
    * Name of the file this object represents.
@@ -352,9 +839,9 @@ class File {
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * State of the file, shared with the other File objects of the file.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<OpenFile> open_;
 
   /**
    * Whether this file is valid.
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <cassert>
+#include <memory>
 
 #include "file.h"
 #include "page.h"
@@ -51,6 +52,26 @@ class FileIterator {
   FileIterator(File *file, PageId page_number)
       : file_(file), current_page_number_(page_number) {}
 
+  /**
+   * Copies an iterator.  The copy points to the same page but reads it into
+   * its own buffer.
+   *
+   * @param other   Iterator to copy.
+   */
+  FileIterator(const FileIterator &other)
+      : file_(other.file_), current_page_number_(other.current_page_number_) {}
+
+  /**
+   * Assigns an iterator, keeping this iterator's page buffer.
+   *
+   * @param rhs   Iterator to copy.
+   */
+  FileIterator &operator=(const FileIterator &rhs) {
+    file_ = rhs.file_;
+    current_page_number_ = rhs.current_page_number_;
+    return *this;
+  }
+
   /**
    * Advances the iterator to the next page in the file.
    */
@@ -90,15 +111,30 @@ class FileIterator {
   }
 
   /**
-   * Dereferences the iterator, returning a copy of the current page in the
-   * file.
+   * Dereferences the iterator, reading the current page in the file into a
+   * buffer owned by the iterator.  The buffer is reused by later
+   * dereferences, so the reference is valid until the iterator is next
+   * dereferenced or destroyed.
    *
    * @return  Page in file.
    */
-  inline Page operator*() const {
-    return file_->readPage(current_page_number_);
+  inline const Page &operator*() const {
+    assert(file_ != NULL);
+    if (!page_) {
+      page_.reset(new Page());
+    }
+    file_->readPage(current_page_number_, *page_);
+    return *page_;
   }
 
+  /**
+   * Returns the number of the page the iterator points to, without reading
+   * the page.
+   *
+   * @return  Page number.
+   */
+  PageId page_number() const { return current_page_number_; }
+
  private:
   /**
    * File we're iterating over.
@@ -109,6 +145,11 @@ class FileIterator {
    * Number of page in file iterator is currently pointing to.
    */
   PageId current_page_number_;
+
+  /**
+   * Buffer the current page is read into, allocated on first dereference.
+   */
+  mutable std::unique_ptr<Page> page_;
 };
 
 }  // namespace badgerdb
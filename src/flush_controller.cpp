@@ -0,0 +1,87 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "flush_controller.h"
+
+#include <algorithm>
+
+namespace badgerdb {
+
+constexpr double FlushController::SMOOTHING;
+
+FlushController::FlushController(const FlushPolicy &policy)
+    : policy_(policy), writeBackRate_(0), dirtyRate_(0) {}
+
+std::uint32_t FlushController::pagesToFlush(
+    const std::uint32_t dirtyFrames, const std::uint32_t totalFrames) const {
+  if (totalFrames == 0 || dirtyFrames == 0) {
+    return 0;
+  }
+  const double ratio = static_cast<double>(dirtyFrames) / totalFrames;
+  if (ratio <= policy_.lowDirtyRatio) {
+    return 0;
+  }
+  const double span = policy_.targetDirtyRatio - policy_.lowDirtyRatio;
+  const double pressure =
+      span > 0 ? std::min(1.0, (ratio - policy_.lowDirtyRatio) / span) : 1.0;
+
+  // Keep up with the writers, then work off the backlog as pressure builds.
+  // Past the target ratio the round cap no longer applies, so a write burst
+  // cannot outrun the flusher.
+  const double perRound =
+      std::chrono::duration<double>(policy_.interval).count();
+  const double keepUp = dirtyRate_ * perRound;
+  const double wanted =
+      std::max(keepUp, pressure * policy_.maxPagesPerRound);
+  const double cap = ratio >= policy_.targetDirtyRatio
+                         ? static_cast<double>(dirtyFrames)
+                         : policy_.maxPagesPerRound;
+  const std::uint32_t pages =
+      static_cast<std::uint32_t>(std::min(std::max(1.0, wanted), cap));
+  return std::min(pages, dirtyFrames);
+}
+
+std::chrono::microseconds FlushController::throttleDelay(
+    const std::uint32_t dirtyFrames, const std::uint32_t totalFrames) const {
+  if (totalFrames == 0) {
+    return std::chrono::microseconds(0);
+  }
+  const double ratio = static_cast<double>(dirtyFrames) / totalFrames;
+  if (ratio <= policy_.throttleDirtyRatio) {
+    return std::chrono::microseconds(0);
+  }
+  const double pressure = std::min(
+      1.0, (ratio - policy_.throttleDirtyRatio) /
+               std::max(1e-9, 1.0 - policy_.throttleDirtyRatio));
+  const double maxDelay = static_cast<double>(policy_.maxThrottleDelay.count());
+  // Roughly the time the disk needs to clean the page the caller dirtied.
+  const double perPage =
+      writeBackRate_ > 0 ? std::min(maxDelay, 1e6 / writeBackRate_) : maxDelay;
+  return std::chrono::microseconds(
+      static_cast<std::chrono::microseconds::rep>(perPage * pressure));
+}
+
+void FlushController::recordRound(const std::uint32_t dirtied,
+                                  const std::uint32_t written,
+                                  const std::chrono::nanoseconds writeTime,
+                                  const std::chrono::nanoseconds roundTime) {
+  const double roundSeconds = std::chrono::duration<double>(roundTime).count();
+  if (roundSeconds > 0) {
+    dirtyRate_ = (1 - SMOOTHING) * dirtyRate_ +
+                 SMOOTHING * (dirtied / roundSeconds);
+  }
+  const double writeSeconds = std::chrono::duration<double>(writeTime).count();
+  if (written > 0 && writeSeconds > 0) {
+    const double sample = written / writeSeconds;
+    writeBackRate_ = writeBackRate_ > 0 ? (1 - SMOOTHING) * writeBackRate_ +
+                                              SMOOTHING * sample
+                                        : sample;
+  }
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,160 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace badgerdb {
+
+/**
+ * @brief Tuning knobs for background write-back and write throttling.
+ */
+struct FlushPolicy {
+  /**
+   * Dirty fraction of the pool below which the background flusher idles.
+   */
+  double lowDirtyRatio;
+
+  /**
+   * Dirty fraction the background flusher tries to stay under.  At or above
+   * it, every round writes back at least maxPagesPerRound pages, and more if
+   * that is needed to keep up with the dirtying rate.
+   */
+  double targetDirtyRatio;
+
+  /**
+   * Dirty fraction above which callers that dirty pages are delayed.
+   */
+  double throttleDirtyRatio;
+
+  /**
+   * Time between background write-back rounds.
+   */
+  std::chrono::milliseconds interval;
+
+  /**
+   * Maximum number of pages written back per round while the dirty fraction
+   * is below targetDirtyRatio.
+   */
+  std::uint32_t maxPagesPerRound;
+
+  /**
+   * Longest delay imposed on a single dirtying caller.
+   */
+  std::chrono::microseconds maxThrottleDelay;
+
+  /**
+   * Constructs the default policy.
+   */
+  FlushPolicy()
+      : lowDirtyRatio(0.10),
+        targetDirtyRatio(0.30),
+        throttleDirtyRatio(0.60),
+        interval(10),
+        maxPagesPerRound(64),
+        maxThrottleDelay(2000) {}
+};
+
+/**
+ * @brief Decides how hard the background flusher works and how long dirtying
+ * callers are delayed.
+ *
+ * The controller keeps exponentially weighted estimates of the rate at which
+ * pages are dirtied and the rate at which they are written back.  Write-back
+ * intensity grows with the dirty ratio between the low and target ratios and
+ * is never less than what is needed to keep up with the dirtying rate; below
+ * the target ratio it is capped at maxPagesPerRound, above it the cap is
+ * lifted so a write burst cannot outrun the flusher.  Above
+ * the throttle ratio, dirtying callers are delayed by roughly the time it
+ * takes the disk to clean one page, scaled by how far over the ratio the
+ * pool is.
+ *
+ * @warning This class is not threadsafe.
+ */
+class FlushController {
+ public:
+  /**
+   * Constructs a controller for the given policy.
+   *
+   * @param policy  Flushing policy.
+   */
+  explicit FlushController(const FlushPolicy &policy);
+
+  /**
+   * Returns the flushing policy.
+   */
+  const FlushPolicy &policy() const { return policy_; }
+
+  /**
+   * Returns the number of pages the next background round should write back.
+   *
+   * @param dirtyFrames   Number of dirty frames in the pool.
+   * @param totalFrames   Number of frames in the pool.
+   * @return  Number of pages to write back.
+   */
+  std::uint32_t pagesToFlush(const std::uint32_t dirtyFrames,
+                             const std::uint32_t totalFrames) const;
+
+  /**
+   * Returns how long a caller that just dirtied a page should be delayed.
+   *
+   * @param dirtyFrames   Number of dirty frames in the pool.
+   * @param totalFrames   Number of frames in the pool.
+   * @return  Delay, zero if the caller should not be throttled.
+   */
+  std::chrono::microseconds throttleDelay(
+      const std::uint32_t dirtyFrames, const std::uint32_t totalFrames) const;
+
+  /**
+   * Records the pages dirtied and written back during one round.
+   *
+   * @param dirtied       Number of clean frames that became dirty.
+   * @param written       Number of pages written back.
+   * @param writeTime     Time spent writing those pages.
+   * @param roundTime     Length of the round.
+   */
+  void recordRound(const std::uint32_t dirtied, const std::uint32_t written,
+                   const std::chrono::nanoseconds writeTime,
+                   const std::chrono::nanoseconds roundTime);
+
+  /**
+   * Returns the estimated write-back rate in pages per second, or 0 if no
+   * pages have been written yet.
+   */
+  double writeBackRate() const { return writeBackRate_; }
+
+  /**
+   * Returns the estimated dirtying rate in pages per second.
+   */
+  double dirtyRate() const { return dirtyRate_; }
+
+ private:
+  /**
+   * Weight given to the newest sample in the rate estimates.
+   */
+  static constexpr double SMOOTHING = 0.2;
+
+  /**
+   * Flushing policy.
+   */
+  FlushPolicy policy_;
+
+  /**
+   * Estimated pages written back per second of write time.
+   */
+  double writeBackRate_;
+
+  /**
+   * Estimated pages dirtied per second.
+   */
+  double dirtyRate_;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,83 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "frequency_sketch.h"
+
+#include <algorithm>
+
+namespace badgerdb {
+
+const int FrequencySketch::DEPTH;
+const std::uint8_t FrequencySketch::MAX_COUNT;
+
+FrequencySketch::FrequencySketch(const std::uint32_t capacity)
+    : width_(64), samples_(0), sampleSize_(10 * std::max(capacity, 1u)) {
+  while (width_ < 2 * capacity) {
+    width_ *= 2;
+  }
+  counters_.assign(DEPTH * width_, 0);
+  doorkeeper_.assign(8 * width_, false);
+}
+
+void FrequencySketch::increment(const std::uint64_t key) {
+  const std::size_t bit0 = slot(key, DEPTH, doorkeeper_.size());
+  const std::size_t bit1 = slot(key, DEPTH + 1, doorkeeper_.size());
+  if (!doorkeeper_[bit0] || !doorkeeper_[bit1]) {
+    doorkeeper_[bit0] = doorkeeper_[bit1] = true;
+  } else {
+    // Conservative update: only the smallest counters grow, which keeps
+    // over-estimates from collisions down.
+    const std::uint32_t current = frequency(key) - 1;
+    if (current < MAX_COUNT) {
+      for (int row = 0; row < DEPTH; row++) {
+        std::uint8_t &counter = counters_[row * width_ + slot(key, row, width_)];
+        if (counter == current) {
+          counter++;
+        }
+      }
+    }
+  }
+  if (++samples_ >= sampleSize_) {
+    age();
+  }
+}
+
+std::uint32_t FrequencySketch::frequency(const std::uint64_t key) const {
+  if (!doorkeeper_[slot(key, DEPTH, doorkeeper_.size())] ||
+      !doorkeeper_[slot(key, DEPTH + 1, doorkeeper_.size())]) {
+    return 0;
+  }
+  std::uint32_t count = MAX_COUNT;
+  for (int row = 0; row < DEPTH; row++) {
+    count = std::min<std::uint32_t>(
+        count, counters_[row * width_ + slot(key, row, width_)]);
+  }
+  return count + 1;
+}
+
+std::uint32_t FrequencySketch::slot(const std::uint64_t key, const int probe,
+                                    const std::size_t size) {
+  // Double hashing over a mixed key (splitmix64 finalizer).
+  std::uint64_t h = key;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  const std::uint32_t h1 = static_cast<std::uint32_t>(h);
+  const std::uint32_t h2 = static_cast<std::uint32_t>(h >> 32) | 1;
+  return (h1 + probe * h2) & (size - 1);
+}
+
+void FrequencySketch::age() {
+  for (std::uint8_t &counter : counters_) {
+    counter >>= 1;
+  }
+  std::fill(doorkeeper_.begin(), doorkeeper_.end(), false);
+  samples_ /= 2;
+}
+
+}  // namespace badgerdb
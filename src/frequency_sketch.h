@@ -0,0 +1,104 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+ * @brief Approximate access frequencies of recently used keys (TinyLFU).
+ *
+ * Frequencies are kept in a count-min sketch of four rows of saturating
+ * 4-bit counters.  A key's first access only sets it in a doorkeeper Bloom
+ * filter, so the many keys seen once never reach the sketch.  After a sample
+ * of accesses proportional to the capacity, every counter is halved and the
+ * doorkeeper is cleared, so that old popularity fades.
+ *
+ * @warning This class is not threadsafe.
+ */
+class FrequencySketch {
+ public:
+  /**
+   * Sizes the sketch for the number of keys whose frequency matters, e.g.
+   * the number of buffer frames.
+   *
+   * @param capacity  Number of keys
+   */
+  explicit FrequencySketch(const std::uint32_t capacity);
+
+  /**
+   * Records an access to a key.
+   *
+   * @param key   Hash of the key
+   */
+  void increment(const std::uint64_t key);
+
+  /**
+   * Returns the estimated number of recent accesses to a key, at most 16.
+   *
+   * @param key   Hash of the key
+   */
+  std::uint32_t frequency(const std::uint64_t key) const;
+
+ private:
+  /**
+   * Number of rows of the count-min sketch.
+   */
+  static const int DEPTH = 4;
+
+  /**
+   * Largest value of a counter.
+   */
+  static const std::uint8_t MAX_COUNT = 15;
+
+  /**
+   * Returns the i-th probe position of a key in a table of the given size.
+   *
+   * @param key   Hash of the key
+   * @param probe Probe number
+   * @param size  Table size; a power of two
+   */
+  static std::uint32_t slot(const std::uint64_t key, const int probe,
+                            const std::size_t size);
+
+  /**
+   * Halves every counter and clears the doorkeeper.
+   */
+  void age();
+
+  /**
+   * Number of counters per row; a power of two.
+   */
+  std::uint32_t width_;
+
+  /**
+   * Counters, row by row; one counter per byte for simplicity.
+   */
+  std::vector<std::uint8_t> counters_;
+
+  /**
+   * Doorkeeper Bloom filter with two probes per key.
+   */
+  std::vector<bool> doorkeeper_;
+
+  /**
+   * Accesses recorded since the last aging.
+   */
+  std::uint32_t samples_;
+
+  /**
+   * Accesses between agings.
+   */
+  std::uint32_t sampleSize_;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,308 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "io_scheduler.h"
+
+#include <algorithm>
+
+namespace badgerdb {
+
+const int IoScheduler::NUM_CLASSES;
+const std::size_t IoScheduler::MAX_MERGED_PAGES;
+const int IoScheduler::NUM_DISPATCHERS;
+
+IoScheduler::IoScheduler() : stop_(false) {
+  const auto now = std::chrono::steady_clock::now();
+  for (ClassQueue &queue : queues_) {
+    queue.tokens = 0;
+    queue.refilled = now;
+  }
+  for (int k = 0; k < NUM_DISPATCHERS; ++k) {
+    dispatchers_.emplace_back(&IoScheduler::dispatchLoop, this);
+  }
+}
+
+IoScheduler::~IoScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_.notify_all();
+  for (std::thread &dispatcher : dispatchers_) {
+    dispatcher.join();
+  }
+}
+
+void IoScheduler::setLimits(const IoClass io_class,
+                            const IoClassLimits &limits) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ClassQueue &queue = queues_[static_cast<int>(io_class)];
+  queue.limits = limits;
+  queue.tokens = std::max(1.0, limits.burstPages);
+  queue.refilled = std::chrono::steady_clock::now();
+  work_.notify_all();
+  progress_.notify_all();
+}
+
+void IoScheduler::read(const IoClass io_class, File &file,
+                       const PageId page_number, Page &page) {
+  Request request = {Request::READ, &file, &page, nullptr, page_number,
+                     nullptr, false, nullptr};
+  submitOne(io_class, request);
+}
+
+void IoScheduler::write(const IoClass io_class, File &file, const Page &page) {
+  Request request = {Request::WRITE, &file, nullptr, &page,
+                     page.page_number(), nullptr, false, nullptr};
+  submitOne(io_class, request);
+}
+
+void IoScheduler::writeAll(
+    const IoClass io_class,
+    const std::vector<std::pair<File *, const Page *>> &writes,
+    std::vector<std::exception_ptr> &errors) {
+  std::vector<Request> requests;
+  requests.reserve(writes.size());
+  for (const auto &write : writes) {
+    requests.push_back({Request::WRITE, write.first, nullptr, write.second,
+                        write.second->page_number(), nullptr, false, nullptr});
+  }
+  std::vector<Request *> pending;
+  for (Request &request : requests) {
+    pending.push_back(&request);
+  }
+  submit(io_class, pending);
+
+  errors.clear();
+  for (const Request &request : requests) {
+    errors.push_back(request.error);
+  }
+}
+
+void IoScheduler::execute(const IoClass io_class, File &file,
+                          const std::function<void()> &op) {
+  Request request = {Request::OTHER, &file, nullptr, nullptr,
+                     Page::INVALID_NUMBER, &op, false, nullptr};
+  submitOne(io_class, request);
+}
+
+void IoScheduler::submitOne(const IoClass io_class, Request &request) {
+  submit(io_class, std::vector<Request *>(1, &request));
+  if (request.error) {
+    std::rethrow_exception(request.error);
+  }
+}
+
+void IoScheduler::submit(const IoClass io_class,
+                         const std::vector<Request *> &requests) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  ClassQueue &queue = queues_[static_cast<int>(io_class)];
+  for (Request *request : requests) {
+    progress_.wait(lock, [&queue]() {
+      return queue.limits.maxQueued == 0 ||
+             queue.requests.size() < queue.limits.maxQueued;
+    });
+    queue.requests.push_back(request);
+    work_.notify_one();
+  }
+  progress_.wait(lock, [&requests]() {
+    for (const Request *request : requests) {
+      if (!request->done) {
+        return false;
+      }
+    }
+    return true;
+  });
+}
+
+void IoScheduler::dispatchLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    std::vector<Request *> batch;
+    std::chrono::steady_clock::duration wait;
+    if (takeBatch(batch, wait)) {
+      in_flight_.push_back(batch.front());
+      lock.unlock();
+      serve(batch);
+      lock.lock();
+      in_flight_.erase(
+          std::find(in_flight_.begin(), in_flight_.end(), batch.front()));
+      for (Request *request : batch) {
+        request->done = true;
+      }
+      progress_.notify_all();
+      // Requests for the file may have been held back behind this batch.
+      work_.notify_all();
+      continue;
+    }
+
+    bool idle = true;
+    for (const ClassQueue &queue : queues_) {
+      idle = idle && queue.requests.empty();
+    }
+    if (stop_ && idle) {
+      return;
+    }
+    if (idle || wait == std::chrono::steady_clock::duration::max()) {
+      // Nothing queued, or only requests for files busy on other
+      // dispatchers, which wake this one when they finish.
+      work_.wait(lock);
+    } else {
+      // Only rate-limited classes have work; sleep until one earns a token.
+      work_.wait_for(lock, wait);
+    }
+  }
+}
+
+bool IoScheduler::mayServe(const Request &request) const {
+  for (const Request *other : in_flight_) {
+    if (*other->file == *request.file &&
+        (other->kind != Request::READ || request.kind != Request::READ)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool IoScheduler::takeBatch(std::vector<Request *> &batch,
+                            std::chrono::steady_clock::duration &wait) {
+  const auto now = std::chrono::steady_clock::now();
+  wait = std::chrono::steady_clock::duration::max();
+  for (ClassQueue &queue : queues_) {
+    if (queue.requests.empty()) {
+      continue;
+    }
+    std::size_t maxPages = MAX_MERGED_PAGES;
+    const bool limited = queue.limits.pagesPerSecond > 0;
+    if (limited) {
+      refill(queue, now);
+      if (queue.tokens < 1) {
+        const auto untilToken =
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(
+                    (1 - queue.tokens) / queue.limits.pagesPerSecond));
+        wait = std::min(wait, untilToken);
+        continue;
+      }
+      maxPages = std::min(maxPages, static_cast<std::size_t>(queue.tokens));
+    }
+
+    // Take the oldest request whose file is free; later requests for a busy
+    // file stay behind it, so each file sees its requests in order.
+    auto next = queue.requests.begin();
+    std::vector<const File *> held;
+    for (; next != queue.requests.end(); ++next) {
+      const File *file = (*next)->file;
+      if (std::find_if(held.begin(), held.end(), [file](const File *f) {
+            return *f == *file;
+          }) == held.end() &&
+          mayServe(**next)) {
+        break;
+      }
+      held.push_back(file);
+    }
+    if (next == queue.requests.end()) {
+      continue;
+    }
+    Request *first = *next;
+    queue.requests.erase(next);
+    batch.push_back(first);
+    if (first->kind != Request::OTHER) {
+      // Grow a run of consecutive pages of the same file in either direction.
+      PageId low = first->page_number;
+      PageId high = first->page_number;
+      bool grown = true;
+      while (grown && batch.size() < maxPages) {
+        grown = false;
+        for (auto it = queue.requests.begin(); it != queue.requests.end();
+             ++it) {
+          Request *other = *it;
+          if (other->kind != first->kind || *other->file != *first->file) {
+            continue;
+          }
+          if (other->page_number == high + 1) {
+            high = other->page_number;
+          } else if (other->page_number + 1 == low) {
+            low = other->page_number;
+          } else {
+            continue;
+          }
+          batch.push_back(other);
+          queue.requests.erase(it);
+          grown = true;
+          break;
+        }
+      }
+      std::sort(batch.begin(), batch.end(),
+                [](const Request *a, const Request *b) {
+                  return a->page_number < b->page_number;
+                });
+    }
+    if (limited) {
+      queue.tokens -= batch.size();
+    }
+    progress_.notify_all();  // The queue has room again.
+    return true;
+  }
+  return false;
+}
+
+void IoScheduler::serve(std::vector<Request *> &batch) {
+  if (batch.size() > 1) {
+    try {
+      if (batch.front()->kind == Request::READ) {
+        std::vector<Page *> pages;
+        for (Request *request : batch) {
+          pages.push_back(request->target);
+        }
+        batch.front()->file->readPages(batch.front()->page_number,
+                                       pages.size(), pages.data());
+      } else {
+        std::vector<const Page *> pages;
+        for (Request *request : batch) {
+          pages.push_back(request->source);
+        }
+        batch.front()->file->writePages(pages.data(), pages.size());
+      }
+      return;
+    } catch (...) {
+      // Fall through and serve the pages one at a time, so that only the
+      // requests for the offending pages see the error.
+    }
+  }
+
+  for (Request *request : batch) {
+    try {
+      switch (request->kind) {
+        case Request::READ:
+          request->file->readPage(request->page_number, *request->target);
+          break;
+        case Request::WRITE:
+          request->file->writePage(*request->source);
+          break;
+        case Request::OTHER:
+          (*request->op)();
+          break;
+      }
+    } catch (...) {
+      request->error = std::current_exception();
+    }
+  }
+}
+
+void IoScheduler::refill(ClassQueue &queue,
+                         const std::chrono::steady_clock::time_point now) {
+  const double elapsed =
+      std::chrono::duration<double>(now - queue.refilled).count();
+  const double capacity = std::max(1.0, queue.limits.burstPages);
+  queue.tokens = std::min(
+      capacity, queue.tokens + elapsed * queue.limits.pagesPerSecond);
+  queue.refilled = now;
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,336 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Priority classes of I/O requests, from most to least urgent.
+ */
+enum class IoClass {
+  /**
+   * Demand reads, and the allocations and write-backs a caller is blocked on.
+   */
+  FOREGROUND = 0,
+
+  /**
+   * Reads of pages that are expected to be needed soon.
+   */
+  PREFETCH = 1,
+
+  /**
+   * Write-backs issued by the background flusher.
+   */
+  WRITE_BACK = 2,
+
+  /**
+   * Write-backs of whole files, e.g. from BufMgr::flushFile().
+   */
+  CHECKPOINT = 3
+};
+
+/**
+ * @brief Admission limits for one I/O class.
+ */
+struct IoClassLimits {
+  /**
+   * Maximum number of requests queued in the class.  Submitters block while
+   * the queue is full.  0 means unlimited.
+   */
+  std::uint32_t maxQueued;
+
+  /**
+   * Sustained number of pages per second the class may transfer.  0 means
+   * unlimited.
+   */
+  double pagesPerSecond;
+
+  /**
+   * Number of pages the class may transfer in a burst after being idle.
+   */
+  double burstPages;
+
+  /**
+   * Constructs unlimited limits.
+   */
+  IoClassLimits() : maxQueued(0), pagesPerSecond(0), burstPages(0) {}
+};
+
+/**
+ * @brief Carries out all I/O between the buffer manager and its files on a
+ * small set of dispatcher threads, ordering it by priority class.
+ *
+ * Callers submit requests and block until they complete.  Each dispatcher
+ * always serves the most urgent class that has queued requests and available
+ * rate tokens, so background write-back and checkpoints cannot hold up demand
+ * reads.  Page reads and writes queued in the same class for consecutive pages
+ * of one file are merged into a single File::readPages() or
+ * File::writePages() call.
+ *
+ * Several transfers are in flight at once, so a long checkpoint batch does
+ * not hold up a demand read of another file.  Since File does no locking of
+ * its own, a file is only read by several dispatchers at a time; writes and
+ * other operations on a file wait for everything else in flight on it.
+ */
+class IoScheduler {
+ public:
+  /**
+   * Number of I/O classes.
+   */
+  static const int NUM_CLASSES = 4;
+
+  /**
+   * Largest number of pages merged into one transfer.
+   */
+  static const std::size_t MAX_MERGED_PAGES = 32;
+
+  /**
+   * Number of dispatcher threads, and so of transfers in flight at once.
+   */
+  static const int NUM_DISPATCHERS = 4;
+
+  /**
+   * Constructs a scheduler with unlimited classes and starts its
+   * dispatchers.
+   */
+  IoScheduler();
+
+  /**
+   * Stops the dispatchers after they have served every queued request.
+   */
+  ~IoScheduler();
+
+  IoScheduler(const IoScheduler &) = delete;
+  IoScheduler &operator=(const IoScheduler &) = delete;
+
+  /**
+   * Sets the admission limits of a class.
+   *
+   * @param io_class  Class to configure.
+   * @param limits    New limits.
+   */
+  void setLimits(const IoClass io_class, const IoClassLimits &limits);
+
+  /**
+   * Reads a page from a file into the given page object.
+   *
+   * @param io_class    Priority class of the read.
+   * @param file        File to read from.
+   * @param page_number Number of page to read.
+   * @param page        Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or
+   *                                is not currently used.
+   */
+  void read(const IoClass io_class, File &file, const PageId page_number,
+            Page &page);
+
+  /**
+   * Writes a page back to its file.
+   *
+   * @param io_class    Priority class of the write.
+   * @param file        File to write to.
+   * @param page        Page to write.
+   * @throws  InvalidPageException  If the page has been deleted.
+   */
+  void write(const IoClass io_class, File &file, const Page &page);
+
+  /**
+   * Writes a set of pages back to their files.  All writes are queued before
+   * waiting, so writes of consecutive pages can be merged.  A failed write
+   * does not stop the others.
+   *
+   * @param io_class  Priority class of the writes.
+   * @param writes    File and page of each write.
+   * @param errors    Exception raised by each write, or null if it succeeded,
+   *                  is returned via this variable.
+   */
+  void writeAll(const IoClass io_class,
+                const std::vector<std::pair<File *, const Page *>> &writes,
+                std::vector<std::exception_ptr> &errors);
+
+  /**
+   * Runs an arbitrary file operation, such as a page allocation, on a
+   * dispatcher.  No other request for the file is served meanwhile.
+   *
+   * @param io_class  Priority class of the operation.
+   * @param file      File the operation uses.
+   * @param op        Operation to run.  Exceptions it throws are rethrown to
+   *                  the caller.
+   */
+  void execute(const IoClass io_class, File &file,
+               const std::function<void()> &op);
+
+ private:
+  /**
+   * @brief A queued request.
+   */
+  struct Request {
+    enum Kind { READ, WRITE, OTHER };
+
+    /**
+     * What the request does.
+     */
+    Kind kind;
+
+    /**
+     * File read, written or used by the operation.
+     */
+    File *file;
+
+    /**
+     * Page read into, for READ.
+     */
+    Page *target;
+
+    /**
+     * Page written, for WRITE.
+     */
+    const Page *source;
+
+    /**
+     * Number of page read; for WRITE, the number of the page written.
+     */
+    PageId page_number;
+
+    /**
+     * Operation run for OTHER.
+     */
+    const std::function<void()> *op;
+
+    /**
+     * Set by the dispatcher once the request has been served.
+     */
+    bool done;
+
+    /**
+     * Exception raised while serving the request, if any.
+     */
+    std::exception_ptr error;
+  };
+
+  /**
+   * @brief Queue and token bucket of one class.
+   */
+  struct ClassQueue {
+    std::deque<Request *> requests;
+    IoClassLimits limits;
+    double tokens;
+    std::chrono::steady_clock::time_point refilled;
+  };
+
+  /**
+   * Queues requests and waits until the dispatcher has served all of them.
+   *
+   * @param io_class  Class to queue the requests in.
+   * @param requests  Requests to serve.
+   */
+  void submit(const IoClass io_class, const std::vector<Request *> &requests);
+
+  /**
+   * Queues a single request, waits for it and rethrows its error, if any.
+   *
+   * @param io_class  Class to queue the request in.
+   * @param request   Request to serve.
+   */
+  void submitOne(const IoClass io_class, Request &request);
+
+  /**
+   * Body of the dispatcher thread.
+   */
+  void dispatchLoop();
+
+  /**
+   * Returns whether a request may be served alongside the batches in
+   * flight.  Caller must hold mutex_.
+   *
+   * @param request Request to check.
+   */
+  bool mayServe(const Request &request) const;
+
+  /**
+   * Picks the class to serve next and takes its next batch of requests:
+   * either one request, or a run of reads or writes of consecutive pages of
+   * one file.  Caller must hold mutex_.
+   *
+   * @param batch   Requests to serve are returned via this variable.
+   * @param wait    If no class may be served now, the time until one may be
+   *                is returned via this variable.
+   * @return  True if a batch was taken.
+   */
+  bool takeBatch(std::vector<Request *> &batch,
+                 std::chrono::steady_clock::duration &wait);
+
+  /**
+   * Performs the I/O for a batch taken by takeBatch().
+   *
+   * @param batch   Requests to serve.
+   */
+  void serve(std::vector<Request *> &batch);
+
+  /**
+   * Adds the tokens a class has earned since its last refill.
+   *
+   * @param queue   Class to refill.
+   * @param now     Current time.
+   */
+  static void refill(ClassQueue &queue,
+                     const std::chrono::steady_clock::time_point now);
+
+  /**
+   * Guards the queues and request completion flags.
+   */
+  std::mutex mutex_;
+
+  /**
+   * Wakes the dispatcher when work arrives or limits change.
+   */
+  std::condition_variable work_;
+
+  /**
+   * Wakes submitters when a request completes or a queue has room.
+   */
+  std::condition_variable progress_;
+
+  /**
+   * Per-class queues, indexed by IoClass.
+   */
+  ClassQueue queues_[NUM_CLASSES];
+
+  /**
+   * First request of each batch being served.
+   */
+  std::vector<const Request *> in_flight_;
+
+  /**
+   * Set to ask the dispatchers to exit once the queues are empty.
+   */
+  bool stop_;
+
+  /**
+   * Dispatcher threads.
+   */
+  std::vector<std::thread> dispatchers_;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,189 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "latch.h"
+
+#include <climits>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace badgerdb {
+
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t),
+              "Latch word must be usable as a futex.");
+
+namespace {
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+inline void futexWait(std::atomic<std::uint32_t> *word, std::uint32_t value) {
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(word),
+          FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+#else
+  (void)word;
+  (void)value;
+  std::this_thread::yield();
+#endif
+}
+
+inline void futexWakeAll(std::atomic<std::uint32_t> *word) {
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(word),
+          FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+  (void)word;
+#endif
+}
+
+}  // namespace
+
+void RWLatch::lockShared() {
+  int spins = 0;
+  for (;;) {
+    std::uint32_t observed = state_.load(std::memory_order_relaxed);
+    if (!(observed & WRITER)) {
+      if (state_.compare_exchange_weak(observed, observed + 1,
+                                       std::memory_order_acquire)) {
+        return;
+      }
+      continue;
+    }
+    backoff(observed, spins);
+  }
+}
+
+void RWLatch::lockExclusive() {
+  int spins = 0;
+  for (;;) {
+    std::uint32_t observed = state_.load(std::memory_order_relaxed);
+    if ((observed & ~SLEEPERS) == 0) {
+      if (state_.compare_exchange_weak(observed, observed | WRITER,
+                                       std::memory_order_acquire)) {
+        return;
+      }
+      continue;
+    }
+    backoff(observed, spins);
+  }
+}
+
+bool RWLatch::tryLockShared() {
+  std::uint32_t observed = state_.load(std::memory_order_relaxed);
+  while (!(observed & WRITER)) {
+    if (state_.compare_exchange_weak(observed, observed + 1,
+                                     std::memory_order_acquire)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool RWLatch::tryLockExclusive() {
+  std::uint32_t observed = state_.load(std::memory_order_relaxed);
+  while ((observed & ~SLEEPERS) == 0) {
+    if (state_.compare_exchange_weak(observed, observed | WRITER,
+                                     std::memory_order_acquire)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool RWLatch::tryUpgrade() {
+  std::uint32_t observed = state_.load(std::memory_order_relaxed);
+  while ((observed & ~SLEEPERS) == 1) {
+    if (state_.compare_exchange_weak(observed, (observed & SLEEPERS) | WRITER,
+                                     std::memory_order_acquire)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void RWLatch::downgrade() {
+  const std::uint32_t previous = state_.exchange(1, std::memory_order_release);
+  if (previous & SLEEPERS) {
+    futexWakeAll(&state_);
+  }
+}
+
+void RWLatch::unlockShared() {
+  const std::uint32_t previous =
+      state_.fetch_sub(1, std::memory_order_release);
+  if ((previous & READERS) == 1 && (previous & SLEEPERS)) {
+    wakeSleepers();
+  }
+}
+
+void RWLatch::unlockExclusive() {
+  const std::uint32_t previous = state_.exchange(0, std::memory_order_release);
+  if (previous & SLEEPERS) {
+    futexWakeAll(&state_);
+  }
+}
+
+void RWLatch::lock(const LatchMode mode) {
+  if (mode == LatchMode::SHARED) {
+    lockShared();
+  } else if (mode == LatchMode::EXCLUSIVE) {
+    lockExclusive();
+  }
+}
+
+bool RWLatch::tryLock(const LatchMode mode) {
+  if (mode == LatchMode::SHARED) {
+    return tryLockShared();
+  } else if (mode == LatchMode::EXCLUSIVE) {
+    return tryLockExclusive();
+  }
+  return true;
+}
+
+void RWLatch::unlock(const LatchMode mode) {
+  if (mode == LatchMode::SHARED) {
+    unlockShared();
+  } else if (mode == LatchMode::EXCLUSIVE) {
+    unlockExclusive();
+  }
+}
+
+void RWLatch::backoff(std::uint32_t observed, int &spins) {
+  if (spins < SPIN_LIMIT) {
+    ++spins;
+    cpuRelax();
+    return;
+  }
+  if (!(observed & SLEEPERS)) {
+    // Announce that we are going to sleep; if the word changed in the
+    // meantime, let the caller retry instead.
+    if (!state_.compare_exchange_strong(observed, observed | SLEEPERS,
+                                        std::memory_order_relaxed)) {
+      return;
+    }
+    observed |= SLEEPERS;
+  }
+  futexWait(&state_, observed);
+  spins = 0;
+}
+
+void RWLatch::wakeSleepers() {
+  state_.fetch_and(~SLEEPERS, std::memory_order_relaxed);
+  futexWakeAll(&state_);
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,173 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace badgerdb {
+
+/**
+ * @brief Mode in which the contents of a buffer frame are latched.
+ */
+enum class LatchMode {
+  /**
+   * Page is only pinned; its contents are not latched.
+   */
+  NONE,
+
+  /**
+   * Any number of threads may read the page concurrently.
+   */
+  SHARED,
+
+  /**
+   * A single thread may read and modify the page.
+   */
+  EXCLUSIVE
+};
+
+/**
+ * @brief Reader/writer latch that spins briefly before sleeping.
+ *
+ * The whole latch is one 32-bit word: a writer bit, a sleepers bit and a
+ * reader count.  Uncontended acquisition is a single compare-and-swap.  Under
+ * contention a thread spins for a bounded number of iterations and then
+ * sleeps on the word with a futex (or yields, where futexes are unavailable).
+ * Releasing the latch wakes sleepers only when the sleepers bit is set.
+ *
+ * Readers are not blocked by waiting writers, so a writer can be delayed for
+ * as long as readers keep overlapping.
+ */
+class RWLatch {
+ public:
+  /**
+   * Constructs an unlatched latch.
+   */
+  RWLatch() : state_(0) {}
+
+  RWLatch(const RWLatch &) = delete;
+  RWLatch &operator=(const RWLatch &) = delete;
+
+  /**
+   * Acquires the latch in shared mode, blocking while a writer holds it.
+   */
+  void lockShared();
+
+  /**
+   * Acquires the latch in exclusive mode, blocking while anyone holds it.
+   */
+  void lockExclusive();
+
+  /**
+   * Acquires the latch in shared mode only if that is possible right away.
+   *
+   * @return  True if the latch was acquired.
+   */
+  bool tryLockShared();
+
+  /**
+   * Acquires the latch in exclusive mode only if that is possible right away.
+   *
+   * @return  True if the latch was acquired.
+   */
+  bool tryLockExclusive();
+
+  /**
+   * Converts a shared latch held by the caller into an exclusive one if the
+   * caller is the only reader.  Never blocks, so two readers upgrading at the
+   * same time cannot deadlock; on failure the caller still holds its shared
+   * latch.
+   *
+   * @return  True if the latch is now held exclusively.
+   */
+  bool tryUpgrade();
+
+  /**
+   * Converts an exclusive latch held by the caller into a shared one, letting
+   * other readers in.
+   */
+  void downgrade();
+
+  /**
+   * Releases a shared latch held by the caller.
+   */
+  void unlockShared();
+
+  /**
+   * Releases an exclusive latch held by the caller.
+   */
+  void unlockExclusive();
+
+  /**
+   * Acquires the latch in the given mode.  LatchMode::NONE is a no-op.
+   *
+   * @param mode  Mode to acquire.
+   */
+  void lock(const LatchMode mode);
+
+  /**
+   * Acquires the latch in the given mode only if that is possible right away.
+   * LatchMode::NONE always succeeds.
+   *
+   * @param mode  Mode to acquire.
+   * @return  True if the latch was acquired.
+   */
+  bool tryLock(const LatchMode mode);
+
+  /**
+   * Releases the latch held in the given mode.  LatchMode::NONE is a no-op.
+   *
+   * @param mode  Mode the latch is held in.
+   */
+  void unlock(const LatchMode mode);
+
+ private:
+  /**
+   * Set while a writer holds the latch.
+   */
+  static const std::uint32_t WRITER = 1u << 31;
+
+  /**
+   * Set while at least one thread is (about to be) asleep on the latch word.
+   */
+  static const std::uint32_t SLEEPERS = 1u << 30;
+
+  /**
+   * Bits holding the number of readers.
+   */
+  static const std::uint32_t READERS = SLEEPERS - 1;
+
+  /**
+   * Number of times a blocked thread re-checks the latch before sleeping.
+   */
+  static const int SPIN_LIMIT = 128;
+
+  /**
+   * Spins or sleeps once on behalf of a blocked thread.  After SPIN_LIMIT
+   * spins the sleepers bit is set and the thread sleeps until the word
+   * changes.
+   *
+   * @param observed  Latch word the caller saw when it failed to acquire.
+   * @param spins     Number of spins so far; reset once the thread has slept.
+   */
+  void backoff(std::uint32_t observed, int &spins);
+
+  /**
+   * Clears the sleepers bit and wakes every thread sleeping on the latch.
+   */
+  void wakeSleepers();
+
+  /**
+   * Latch word: WRITER | SLEEPERS | reader count.
+   */
+  std::atomic<std::uint32_t> state_;
+};
+
+}  // namespace badgerdb
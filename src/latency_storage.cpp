@@ -0,0 +1,61 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "latency_storage.h"
+
+#include <thread>
+
+namespace badgerdb {
+
+void LatencyStorage::read(const std::uint64_t offset, char *data,
+                          const std::size_t length) {
+  std::this_thread::sleep_for(readLatency_);
+  inner_->read(offset, data, length);
+}
+
+void LatencyStorage::write(const std::uint64_t offset, const char *data,
+                           const std::size_t length) {
+  std::this_thread::sleep_for(writeLatency_);
+  inner_->write(offset, data, length);
+}
+
+void LatencyStorage::readv(const std::uint64_t offset, const IoBuffer *buffers,
+                           const std::size_t count) {
+  std::this_thread::sleep_for(readLatency_);
+  inner_->readv(offset, buffers, count);
+}
+
+void LatencyStorage::writev(const std::uint64_t offset,
+                            const ConstIoBuffer *buffers,
+                            const std::size_t count) {
+  std::this_thread::sleep_for(writeLatency_);
+  inner_->writev(offset, buffers, count);
+}
+
+void LatencyStorage::sync() {
+  std::this_thread::sleep_for(writeLatency_);
+  inner_->sync();
+}
+
+void LatencyStorage::punchHole(const std::uint64_t offset,
+                               const std::uint64_t length) {
+  std::this_thread::sleep_for(writeLatency_);
+  inner_->punchHole(offset, length);
+}
+
+void LatencyStorage::truncate(const std::uint64_t size) {
+  std::this_thread::sleep_for(writeLatency_);
+  inner_->truncate(size);
+}
+
+void LatencyStorage::snapshot(const std::string &name) {
+  std::this_thread::sleep_for(writeLatency_);
+  inner_->snapshot(name);
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,72 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "storage_backend.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Storage that adds a fixed latency to every request of the storage
+ * it wraps, to simulate a slower device.
+ *
+ * A vectored request pays the latency once, and concurrent requests overlap
+ * their latencies, as they would on a device with a deep queue.
+ */
+class LatencyStorage : public StorageBackend {
+ public:
+  /**
+   * Wraps a storage.
+   *
+   * @param inner         Storage that serves the requests.
+   * @param readLatency   Latency added to each read request.
+   * @param writeLatency  Latency added to each write request.
+   */
+  LatencyStorage(const std::shared_ptr<StorageBackend> &inner,
+                 const std::chrono::microseconds readLatency,
+                 const std::chrono::microseconds writeLatency)
+      : inner_(inner), readLatency_(readLatency), writeLatency_(writeLatency) {}
+
+  void read(const std::uint64_t offset, char *data,
+            const std::size_t length) override;
+  void write(const std::uint64_t offset, const char *data,
+             const std::size_t length) override;
+  void readv(const std::uint64_t offset, const IoBuffer *buffers,
+             const std::size_t count) override;
+  void writev(const std::uint64_t offset, const ConstIoBuffer *buffers,
+              const std::size_t count) override;
+  void sync() override;
+  std::uint64_t size() override { return inner_->size(); }
+  void punchHole(const std::uint64_t offset,
+                 const std::uint64_t length) override;
+  void truncate(const std::uint64_t size) override;
+  void snapshot(const std::string &name) override;
+
+ private:
+  /**
+   * Storage that serves the requests.
+   */
+  std::shared_ptr<StorageBackend> inner_;
+
+  /**
+   * Latency added to each read request.
+   */
+  std::chrono::microseconds readLatency_;
+
+  /**
+   * Latency added to each write request, and to sync().
+   */
+  std::chrono::microseconds writeLatency_;
+};
+
+}  // namespace badgerdb
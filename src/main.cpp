@@ -1,20 +1,35 @@
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <iostream>
 //#include <stdio.h>
 #include <cstring>
+#include <chrono>
+#include <map>
 #include <memory>
 #include <optional>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/invalid_page_exception.h"
+#include "exceptions/io_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "file_iterator.h"
 #include "page.h"
 #include "page_iterator.h"
+#include "segmented_storage.h"
+#include "shared_buffer_pool.h"
+#include "shared_scan.h"
+#include "striped_storage.h"
 
 #define PRINT_ERROR(str)                            \
   {                                                 \
@@ -40,6 +55,32 @@ void test3(File &file4);
 void test4(File &file4);
 void test5(File &file4);
 void test6(File &file1);
+void test7(File &file2);
+void test8(File &file3);
+void test9(File &file1);
+void test10(File &file4);
+void test11(File &file5);
+void test12(File &file3);
+void test13(File &file3);
+void test14(File &file2);
+void test15(File &file1);
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23(File &file1);
+void test24(File &file1);
+void test25();
+void test26();
+void test27();
+void test28();
+void test29();
+void test30();
+void test31();
+void test32();
 // Calls the above tests
 void testBufMgr();
 
@@ -142,6 +183,32 @@ void testBufMgr() {
     test4(file4);
     test5(file5);
     test6(file1);
+    test7(file2);
+    test8(file3);
+    test9(file1);
+    test10(file4);
+    test11(file5);
+    test12(file3);
+    test13(file3);
+    test14(file2);
+    test15(file1);
+    test16();
+    test17();
+    test18();
+    test19();
+    test20();
+    test21();
+    test22();
+    test23(file1);
+    test24(file1);
+    test25();
+    test26();
+    test27();
+    test28();
+    test29();
+    test30();
+    test31();
+    test32();
 
     // Close the files by going out of scope
   }
@@ -162,7 +229,7 @@ void test1(File &file1) {
   // Allocating pages in a file...
   for (i = 0; i < num; i++) {
     bufMgr->allocPage(file1, pid[i], page);
-    sprintf(tmpbuf, "test.1 Page %u %7.1f", pid[i], (float)pid[i]);
+    sprintf(tmpbuf, "test.1 Page %" PRIuPAGEID " %7.1f", pid[i], (float)pid[i]);
     rid[i] = page->insertRecord(tmpbuf);
     bufMgr->unPinPage(file1, pid[i], true);
   }
@@ -170,7 +237,7 @@ void test1(File &file1) {
   // Reading pages back...
   for (i = 0; i < num; i++) {
     bufMgr->readPage(file1, pid[i], page);
-    sprintf(tmpbuf, "test.1 Page %u %7.1f", pid[i], (float)pid[i]);
+    sprintf(tmpbuf, "test.1 Page %" PRIuPAGEID " %7.1f", pid[i], (float)pid[i]);
     if (strncmp(page->getRecord(rid[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0) {
       PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
     }
@@ -188,30 +255,35 @@ void test2(File &file1, File &file2, File &file3) {
   std::cout<<"Entering for loop\n\n";
   for (i = 0; i < num / 3; i++) {
     bufMgr->allocPage(file2, pageno2, page2);
-    sprintf(tmpbuf, "test.2 Page %u %7.1f", pageno2, (float)pageno2);
+    sprintf(tmpbuf, "test.2 Page %" PRIuPAGEID " %7.1f", pageno2,
+            (float)pageno2);
     rid2 = page2->insertRecord(tmpbuf);
 
     long int index = rand() % num;
     pageno1 = pid[index];
     bufMgr->readPage(file1, pageno1, page);
-    sprintf(tmpbuf, "test.1 Page %u %7.1f", pageno1, (float)pageno1);
+    sprintf(tmpbuf, "test.1 Page %" PRIuPAGEID " %7.1f", pageno1,
+            (float)pageno1);
     if (strncmp(page->getRecord(rid[index]).c_str(), tmpbuf, strlen(tmpbuf)) !=
         0) {
       PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
     }
 
     bufMgr->allocPage(file3, pageno3, page3);
-    sprintf(tmpbuf, "test.3 Page %u %7.1f", pageno3, (float)pageno3);
+    sprintf(tmpbuf, "test.3 Page %" PRIuPAGEID " %7.1f", pageno3,
+            (float)pageno3);
     rid3 = page3->insertRecord(tmpbuf);
 
     bufMgr->readPage(file2, pageno2, page2);
-    sprintf(tmpbuf, "test.2 Page %u %7.1f", pageno2, (float)pageno2);
+    sprintf(tmpbuf, "test.2 Page %" PRIuPAGEID " %7.1f", pageno2,
+            (float)pageno2);
     if (strncmp(page2->getRecord(rid2).c_str(), tmpbuf, strlen(tmpbuf)) != 0) {
       PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
     }
 
     bufMgr->readPage(file3, pageno3, page3);
-    sprintf(tmpbuf, "test.3 Page %u %7.1f", pageno3, (float)pageno3);
+    sprintf(tmpbuf, "test.3 Page %" PRIuPAGEID " %7.1f", pageno3,
+            (float)pageno3);
     if (strncmp(page3->getRecord(rid3).c_str(), tmpbuf, strlen(tmpbuf)) != 0) {
       PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
     }
@@ -262,7 +334,7 @@ void test4(File &file4) {
 void test5(File &file5) {
   for (i = 0; i < num; i++) {
     bufMgr->allocPage(file5, pid[i], page);
-    sprintf(tmpbuf, "test.5 Page %u %7.1f", pid[i], (float)pid[i]);
+    sprintf(tmpbuf, "test.5 Page %" PRIuPAGEID " %7.1f", pid[i], (float)pid[i]);
     rid[i] = page->insertRecord(tmpbuf);
   }
 
@@ -302,3 +374,1417 @@ void test6(File &file1) {
 
   bufMgr->flushFile(file1);
 }
+
+void test7(File &file2) {
+  // Concurrent readers share a latched page while writers take turns
+  // inserting records under an exclusive latch.
+  const int numThreads = 8;
+  const int insertsPerThread = 20;
+  PageId pageNo;
+  bufMgr->allocPage(file2, pageNo, page);
+  bufMgr->unPinPage(file2, pageNo, true);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < numThreads; t++) {
+    threads.emplace_back([&file2, pageNo, t]() {
+      Page *p;
+      for (int k = 0; k < insertsPerThread; k++) {
+        if (t % 2 == 0) {
+          bufMgr->readPage(file2, pageNo, p, LatchMode::EXCLUSIVE);
+          p->insertRecord("x");
+          bufMgr->unPinPage(file2, pageNo, true, LatchMode::EXCLUSIVE);
+        } else {
+          bufMgr->readPage(file2, pageNo, p, LatchMode::SHARED);
+          // Inserting needs no re-validation if the upgrade had to wait.
+          bufMgr->upgradeLatch(file2, pageNo);
+          p->insertRecord("y");
+          bufMgr->unPinPage(file2, pageNo, true, LatchMode::EXCLUSIVE);
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) thread.join();
+
+  bufMgr->readPage(file2, pageNo, page, LatchMode::SHARED);
+  int records = 0;
+  for (PageIterator iter = page->begin(); iter != page->end(); ++iter) {
+    records++;
+  }
+  if (records != numThreads * insertsPerThread) {
+    PRINT_ERROR("ERROR :: LATCHED INSERTS WERE LOST");
+  }
+  if (bufMgr->tryLatchPage(file2, pageNo, LatchMode::EXCLUSIVE)) {
+    PRINT_ERROR("ERROR :: EXCLUSIVE LATCH GRANTED WHILE SHARED LATCH HELD");
+  }
+  bufMgr->unPinPage(file2, pageNo, false, LatchMode::SHARED);
+  bufMgr->flushFile(file2);
+
+  std::cout << "Test 7 passed"
+            << "\n";
+}
+
+void test8(File &file3) {
+  // The background flusher should write back dirty pages on its own, without
+  // any eviction or flushFile call.
+  const PageId dirtyPages = num / 2;
+  for (i = 0; i < dirtyPages; i++) {
+    bufMgr->allocPage(file3, pid[i], page);
+    sprintf(tmpbuf, "test.3 Page %" PRIuPAGEID " %7.1f", pid[i], (float)pid[i]);
+    rid[i] = page->insertRecord(tmpbuf);
+    bufMgr->unPinPage(file3, pid[i], true);
+  }
+  bufMgr->clearBufStats();
+
+  FlushPolicy policy;
+  policy.lowDirtyRatio = 0;
+  policy.interval = std::chrono::milliseconds(1);
+  bufMgr->startBackgroundFlusher(policy);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  bufMgr->stopBackgroundFlusher();
+
+  if (bufMgr->getBufStats().diskwrites != (int)dirtyPages) {
+    PRINT_ERROR("ERROR :: BACKGROUND FLUSHER DID NOT WRITE BACK DIRTY PAGES");
+  }
+  bufMgr->flushFile(file3);
+  if (bufMgr->getBufStats().diskwrites != (int)dirtyPages) {
+    PRINT_ERROR("ERROR :: FLUSHED PAGES WERE WRITTEN AGAIN");
+  }
+  for (i = 0; i < dirtyPages; i++) {
+    Page onDisk = file3.readPage(pid[i]);
+    sprintf(tmpbuf, "test.3 Page %" PRIuPAGEID " %7.1f", pid[i], (float)pid[i]);
+    if (strncmp(onDisk.getRecord(rid[i]).c_str(), tmpbuf, strlen(tmpbuf)) !=
+        0) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+  }
+
+  // Above the target ratio the flusher keeps up with a write burst even when
+  // that takes more than maxPagesPerRound pages; below it the cap holds.
+  FlushPolicy capped;
+  capped.maxPagesPerRound = 4;
+  FlushController controller(capped);
+  controller.recordRound(1000, 0, std::chrono::nanoseconds(0),
+                         std::chrono::milliseconds(10));
+  if (controller.pagesToFlush(500, 1000) < 100) {
+    PRINT_ERROR("ERROR :: FLUSHER FELL BEHIND A WRITE BURST");
+  }
+  if (controller.pagesToFlush(200, 1000) != capped.maxPagesPerRound) {
+    PRINT_ERROR("ERROR :: FLUSHER IGNORED THE ROUND CAP");
+  }
+
+  std::cout << "Test 8 passed"
+            << "\n";
+}
+
+void test9(File &file1) {
+  // A scan that starts while another is in progress joins it at its current
+  // page and wraps around; both must still see every page exactly once.
+  SharedScanCoordinator coordinator(bufMgr.get());
+  std::set<PageId> seenFirst, seenSecond;
+  {
+    SharedScan first(coordinator, file1);
+    for (i = 0; i < num / 2; i++) {
+      if (!first.next(page)) PRINT_ERROR("ERROR :: SCAN ENDED EARLY");
+      seenFirst.insert(page->page_number());
+    }
+    const PageId joinedAt = first.currentPageNumber();
+
+    SharedScan second(coordinator, file1);
+    if (coordinator.activeScans(file1.filename()) != 2) {
+      PRINT_ERROR("ERROR :: SCANS WERE NOT GROUPED");
+    }
+    bool more = true;
+    while (more) {
+      more = false;
+      if (first.next(page)) {
+        if (!seenFirst.insert(page->page_number()).second) {
+          PRINT_ERROR("ERROR :: PAGE SCANNED TWICE");
+        }
+        more = true;
+      }
+      if (second.next(page)) {
+        if (seenSecond.empty() && page->page_number() != joinedAt) {
+          PRINT_ERROR("ERROR :: SCAN DID NOT JOIN AT CURRENT POSITION");
+        }
+        if (!seenSecond.insert(page->page_number()).second) {
+          PRINT_ERROR("ERROR :: PAGE SCANNED TWICE");
+        }
+        more = true;
+      }
+    }
+  }
+  if (seenFirst.size() != num || seenSecond.size() != num) {
+    PRINT_ERROR("ERROR :: SHARED SCANS MISSED PAGES");
+  }
+  if (coordinator.activeScans(file1.filename()) != 0) {
+    PRINT_ERROR("ERROR :: SCAN GROUP NOT DISSOLVED");
+  }
+
+  // A lagging member must not pull the group's position back, so a later
+  // scan still joins at the furthest page read.
+  {
+    SharedScan leader(coordinator, file1);
+    for (i = 0; i < 10; i++) leader.next(page);
+    SharedScan laggard(coordinator, file1);
+    for (i = 0; i < 10; i++) leader.next(page);
+    const PageId furthest = leader.currentPageNumber();
+    laggard.next(page);
+    SharedScan joiner(coordinator, file1);
+    if (!joiner.next(page) || page->page_number() != furthest) {
+      PRINT_ERROR("ERROR :: SCAN GROUP POSITION MOVED BACKWARDS");
+    }
+  }
+
+  // A scan too far ahead of the slowest member waits for it to catch up.
+  {
+    SharedScanCoordinator paced(bufMgr.get(), 2,
+                                std::chrono::milliseconds(20));
+    SharedScan leader(paced, file1);
+    leader.next(page);
+    SharedScan laggard(paced, file1);
+    const auto start = std::chrono::steady_clock::now();
+    for (i = 0; i < 3; i++) leader.next(page);
+    if (std::chrono::steady_clock::now() - start <
+        std::chrono::milliseconds(15)) {
+      PRINT_ERROR("ERROR :: SCAN WAS NOT PACED");
+    }
+  }
+
+  // A page deleted after the scan order was fixed is skipped.
+  {
+    PageId extra;
+    bufMgr->allocPage(file1, extra, page);
+    bufMgr->unPinPage(file1, extra, true);
+    std::set<PageId> seen;
+    {
+      SharedScan scan(coordinator, file1);
+      bufMgr->disposePage(file1, extra);
+      try {
+        while (scan.next(page)) seen.insert(page->page_number());
+      } catch (const InvalidPageException &) {
+        PRINT_ERROR("ERROR :: SCAN THREW ON A DELETED PAGE");
+      }
+    }
+    if (seen.size() != num || seen.count(extra) != 0) {
+      PRINT_ERROR("ERROR :: SCAN DID NOT SKIP A DELETED PAGE");
+    }
+  }
+  bufMgr->flushFile(file1);
+
+  std::cout << "Test 9 passed"
+            << "\n";
+}
+
+void test10(File &file4) {
+  // Pages evicted from a small pool should come back from the secondary
+  // cache instead of the file.
+  const PageId numPages = 30;
+  BufMgr smallPool(10);
+  smallPool.enableSecondaryCache("test.cache", 64, 0 /* admitAfterHits */);
+  for (i = 0; i < numPages; i++) {
+    smallPool.allocPage(file4, pid[i], page);
+    sprintf(tmpbuf, "test.4 Page %" PRIuPAGEID " %7.1f", pid[i], (float)pid[i]);
+    rid[i] = page->insertRecord(tmpbuf);
+    smallPool.unPinPage(file4, pid[i], true);
+  }
+  smallPool.clearBufStats();
+
+  for (i = 0; i < numPages; i++) {
+    smallPool.readPage(file4, pid[i], page);
+    sprintf(tmpbuf, "test.4 Page %" PRIuPAGEID " %7.1f", pid[i], (float)pid[i]);
+    if (strncmp(page->getRecord(rid[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+    smallPool.unPinPage(file4, pid[i], false);
+  }
+  // Up to a pool's worth of pages may still be resident; every other read
+  // must be served by the cache.
+  if (smallPool.getBufStats().diskreads != 0 ||
+      smallPool.getBufStats().cachereads < (int)numPages - 10) {
+    PRINT_ERROR("ERROR :: EVICTED PAGES WERE NOT SERVED FROM THE CACHE");
+  }
+  smallPool.flushFile(file4);
+  // The cache lives on temporary storage, so nothing is left behind.
+  smallPool.disableSecondaryCache();
+  if (File::exists("test.cache")) {
+    PRINT_ERROR("ERROR :: SECONDARY CACHE FILE WAS LEFT BEHIND");
+  }
+
+  std::cout << "Test 10 passed"
+            << "\n";
+}
+
+void test11(File &file5) {
+  // Pages evicted from a small pool should be compressed in memory and
+  // decompressed on a later miss instead of read from the file.
+  const PageId numPages = 30;
+  BufMgr smallPool(10);
+  smallPool.enableCompressedCache(1 << 20);
+  for (i = 0; i < numPages; i++) {
+    smallPool.allocPage(file5, pid[i], page);
+    sprintf(tmpbuf, "test.5 Page %" PRIuPAGEID " %7.1f", pid[i], (float)pid[i]);
+    rid[i] = page->insertRecord(tmpbuf);
+    smallPool.unPinPage(file5, pid[i], true);
+  }
+  smallPool.clearBufStats();
+
+  for (i = 0; i < numPages; i++) {
+    smallPool.readPage(file5, pid[i], page);
+    sprintf(tmpbuf, "test.5 Page %" PRIuPAGEID " %7.1f", pid[i], (float)pid[i]);
+    if (strncmp(page->getRecord(rid[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+    smallPool.unPinPage(file5, pid[i], false);
+  }
+  // Up to a pool's worth of pages may still be resident; every other read
+  // must be served by the cache.
+  if (smallPool.getBufStats().diskreads != 0 ||
+      smallPool.getBufStats().cachereads < (int)numPages - 10) {
+    PRINT_ERROR("ERROR :: EVICTED PAGES WERE NOT SERVED FROM THE CACHE");
+  }
+  smallPool.flushFile(file5);
+
+  std::cout << "Test 11 passed"
+            << "\n";
+}
+
+void test12(File &file3) {
+  // With the admission filter, a scan of pages read once should not push
+  // frequently read pages out of a small pool.
+  const PageId numHot = 5;
+  const PageId numPages = 35;
+  BufMgr smallPool(10);
+  smallPool.enableAdmissionFilter(10 /* windowPercent */);
+  for (i = 0; i < numPages; i++) {
+    smallPool.allocPage(file3, pid[i], page);
+    smallPool.unPinPage(file3, pid[i], true);
+  }
+  smallPool.flushFile(file3);
+
+  for (int round = 0; round < 3; round++) {
+    for (i = 0; i < numHot; i++) {
+      smallPool.readPage(file3, pid[i], page);
+      smallPool.unPinPage(file3, pid[i], false);
+    }
+  }
+  for (i = numHot; i < numPages; i++) {
+    smallPool.readPage(file3, pid[i], page);
+    smallPool.unPinPage(file3, pid[i], false);
+  }
+  smallPool.clearBufStats();
+  for (i = 0; i < numHot; i++) {
+    smallPool.readPage(file3, pid[i], page);
+    smallPool.unPinPage(file3, pid[i], false);
+  }
+  if (smallPool.getBufStats().diskreads != 0) {
+    PRINT_ERROR("ERROR :: SCAN EVICTED FREQUENTLY READ PAGES");
+  }
+  smallPool.flushFile(file3);
+
+  std::cout << "Test 12 passed"
+            << "\n";
+}
+
+void test13(File &file3) {
+  // Misses should evict the clean frames of a half-dirty pool before paying
+  // for a write-back.
+  const PageId poolSize = 10;
+  BufMgr smallPool(poolSize);
+  for (i = 0; i < poolSize; i++) {
+    smallPool.readPage(file3, pid[i], page);
+    smallPool.unPinPage(file3, pid[i], i % 2 == 0);
+  }
+  smallPool.clearBufStats();
+  for (i = poolSize; i < poolSize + poolSize / 2; i++) {
+    smallPool.readPage(file3, pid[i], page);
+    smallPool.unPinPage(file3, pid[i], false);
+  }
+  if (smallPool.getBufStats().diskwrites != 0) {
+    PRINT_ERROR("ERROR :: DIRTY FRAME EVICTED WHILE CLEAN FRAMES WERE LEFT");
+  }
+  smallPool.flushFile(file3);
+
+  std::cout << "Test 13 passed"
+            << "\n";
+}
+
+void test14(File &file2) {
+  // Deferred allocations should not touch the file until they are flushed.
+  const PageId numPages = 5;
+  std::uint32_t usedBefore = 0;
+  for (FileIterator iter = file2.begin(); iter != file2.end(); ++iter) {
+    usedBefore++;
+  }
+  BufMgr smallPool(10);
+  for (i = 0; i < numPages; i++) {
+    smallPool.allocPage(file2, pid[i], page, true /* deferred */);
+    sprintf(tmpbuf, "test.2 Page %" PRIuPAGEID " %7.1f", pid[i], (float)pid[i]);
+    rid[i] = page->insertRecord(tmpbuf);
+    smallPool.unPinPage(file2, pid[i], true);
+  }
+  // A deferred page disposed of before its first write leaves a free page.
+  smallPool.disposePage(file2, pid[2]);
+  if (smallPool.getBufStats().diskreads != 0 ||
+      smallPool.getBufStats().diskwrites != 0) {
+    PRINT_ERROR("ERROR :: DEFERRED ALLOCATION WROTE TO DISK");
+  }
+  std::uint32_t used = 0;
+  for (FileIterator iter = file2.begin(); iter != file2.end(); ++iter) {
+    used++;
+  }
+  if (used != usedBefore) {
+    PRINT_ERROR("ERROR :: RESERVED PAGES ARE VISIBLE BEFORE BEING WRITTEN");
+  }
+
+  smallPool.flushFile(file2);
+  used = 0;
+  for (FileIterator iter = file2.begin(); iter != file2.end(); ++iter) {
+    used++;
+  }
+  if (used != usedBefore + numPages - 1) {
+    PRINT_ERROR("ERROR :: FLUSHED RESERVED PAGES ARE NOT IN THE FILE");
+  }
+  for (i = 0; i < numPages; i++) {
+    if (i == 2) {
+      continue;
+    }
+    smallPool.readPage(file2, pid[i], page);
+    sprintf(tmpbuf, "test.2 Page %" PRIuPAGEID " %7.1f", pid[i], (float)pid[i]);
+    if (strncmp(page->getRecord(rid[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+    smallPool.unPinPage(file2, pid[i], false);
+  }
+  smallPool.allocPage(file2, pageno1, page);
+  if (pageno1 != pid[2]) {
+    PRINT_ERROR("ERROR :: DROPPED RESERVATION WAS NOT FREED");
+  }
+  smallPool.unPinPage(file2, pageno1, false);
+  smallPool.flushFile(file2);
+
+  // Deferred pages that are discarded must not reach the file when a later
+  // page is written.
+  for (i = 0; i < 2; i++) {
+    smallPool.allocPage(file2, pid[i], page, true /* deferred */);
+    smallPool.unPinPage(file2, pid[i], true);
+  }
+  smallPool.discardFile(file2);
+  smallPool.allocPage(file2, pageno1, page, true /* deferred */);
+  smallPool.unPinPage(file2, pageno1, true);
+  smallPool.flushFile(file2);
+  used = 0;
+  for (FileIterator iter = file2.begin(); iter != file2.end(); ++iter) {
+    used++;
+  }
+  if (used != usedBefore + numPages + 1) {
+    PRINT_ERROR("ERROR :: DISCARDED DEFERRED PAGES WERE WRITTEN");
+  }
+
+  std::cout << "Test 14 passed"
+            << "\n";
+}
+
+void test15(File &file1) {
+  // A small insert should dirty only the header/slot sector and the sector
+  // holding the record, and writing the page should persist it.
+  BufMgr smallPool(10);
+  smallPool.allocPage(file1, pageno1, page);
+  if (page->dirty_sectors() != 0) {
+    PRINT_ERROR("ERROR :: NEW PAGE HAS DIRTY SECTORS");
+  }
+  rid2 = page->insertRecord("small update");
+  const std::uint32_t lastSector = Page::SIZE / Page::SECTOR_SIZE - 1;
+  if (page->dirty_sectors() != (1u | 1u << lastSector)) {
+    PRINT_ERROR("ERROR :: UNEXPECTED DIRTY SECTORS AFTER INSERT");
+  }
+  smallPool.unPinPage(file1, pageno1, true);
+  smallPool.flushFile(file1);
+
+  Page check = file1.readPage(pageno1);
+  if (check.getRecord(rid2) != "small update" || check.dirty_sectors() != 0) {
+    PRINT_ERROR("ERROR :: PARTIAL WRITE DID NOT PERSIST THE RECORD");
+  }
+  smallPool.disposePage(file1, pageno1);
+
+  std::cout << "Test 15 passed"
+            << "\n";
+}
+
+void test16() {
+  // Files on every storage backend should keep their pages across a close
+  // and reopen.
+  const std::string filename = "test.storage";
+  StorageOptions options[4];
+  options[0].kind = StorageKind::POSIX;
+  options[1].kind = StorageKind::MMAP;
+  options[2].kind = StorageKind::MEMORY;
+  options[3].kind = StorageKind::MEMORY;
+  options[3].readLatency = std::chrono::microseconds(50);
+  options[3].writeLatency = std::chrono::microseconds(50);
+  const PageId numPages = 20;
+  for (const StorageOptions &option : options) {
+    {
+      File file = File::create(filename, option);
+      BufMgr smallPool(10);
+      for (i = 0; i < numPages; i++) {
+        smallPool.allocPage(file, pid[i], page);
+        sprintf(tmpbuf, "test.storage Page %" PRIuPAGEID " %7.1f", pid[i],
+                (float)pid[i]);
+        rid[i] = page->insertRecord(tmpbuf);
+        smallPool.unPinPage(file, pid[i], true);
+      }
+      smallPool.flushFile(file);
+    }
+    {
+      File file = File::open(filename, option);
+      for (i = 0; i < numPages; i++) {
+        sprintf(tmpbuf, "test.storage Page %" PRIuPAGEID " %7.1f", pid[i],
+                (float)pid[i]);
+        if (file.readPage(pid[i]).getRecord(rid[i]) != tmpbuf) {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+      }
+    }
+    File::remove(filename);
+    if (File::exists(filename)) {
+      PRINT_ERROR("ERROR :: REMOVED FILE STILL EXISTS");
+    }
+  }
+
+  std::cout << "Test 16 passed"
+            << "\n";
+}
+
+void test17() {
+  // Temporary files should spill through the pool like any other file, and
+  // leave nothing behind.
+  const PageId numPages = 30;
+  std::string filename;
+  {
+    File file = File::createTemporary();
+    filename = file.filename();
+    if (!file.isTemporary() || File::exists(filename)) {
+      PRINT_ERROR("ERROR :: TEMPORARY FILE IS VISIBLE");
+    }
+    BufMgr smallPool(10);
+    for (i = 0; i < numPages; i++) {
+      smallPool.allocPage(file, pid[i], page);
+      sprintf(tmpbuf, "test.temp Page %" PRIuPAGEID " %7.1f", pid[i],
+              (float)pid[i]);
+      rid[i] = page->insertRecord(tmpbuf);
+      smallPool.unPinPage(file, pid[i], true);
+    }
+    if (smallPool.getBufStats().diskreads != 0) {
+      PRINT_ERROR("ERROR :: TEMPORARY ALLOCATION READ FROM DISK");
+    }
+    for (i = 0; i < numPages; i++) {
+      smallPool.readPage(file, pid[i], page);
+      sprintf(tmpbuf, "test.temp Page %" PRIuPAGEID " %7.1f", pid[i],
+              (float)pid[i]);
+      if (page->getRecord(rid[i]) != tmpbuf) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      smallPool.unPinPage(file, pid[i], false);
+    }
+    smallPool.disposePage(file, pid[3]);
+    std::uint32_t used = 0;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      used++;
+    }
+    if (used != numPages - 1) {
+      PRINT_ERROR("ERROR :: WRONG NUMBER OF USED PAGES");
+    }
+
+    smallPool.readPage(file, pid[0], page);
+    page->insertRecord("never written");
+    smallPool.unPinPage(file, pid[0], true);
+    const int writes = smallPool.getBufStats().diskwrites;
+    smallPool.discardFile(file);
+    smallPool.flushFile(file);
+    if (smallPool.getBufStats().diskwrites != writes) {
+      PRINT_ERROR("ERROR :: DISCARDED PAGES WERE WRITTEN");
+    }
+  }
+  if (File::exists(filename)) {
+    PRINT_ERROR("ERROR :: TEMPORARY FILE WAS LEFT BEHIND");
+  }
+
+  // Temporary files created in parallel must not share a name.
+  {
+    const int numThreads = 8;
+    const int perThread = 50;
+    std::vector<std::vector<File>> created(numThreads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < numThreads; t++) {
+      workers.emplace_back([&created, t]() {
+        for (int n = 0; n < perThread; n++) {
+          created[t].push_back(File::createTemporary());
+        }
+      });
+    }
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+    std::set<std::string> names;
+    for (const std::vector<File> &files : created) {
+      for (const File &file : files) {
+        names.insert(file.filename());
+      }
+    }
+    if (names.size() != numThreads * perThread) {
+      PRINT_ERROR("ERROR :: TEMPORARY FILES SHARED A NAME");
+    }
+  }
+
+  std::cout << "Test 17 passed"
+            << "\n";
+}
+
+void test18() {
+  // A page changed by one process through a shared pool should be seen by
+  // another attached process, whichever process writes it back.
+  const std::string filename = "test.shared";
+  const std::string poolName = "/badgerdb-test-shared";
+  const PageId numPages = 20;
+  SharedBufferPool::remove(poolName);
+  {
+    File file = File::create(filename);
+    for (i = 0; i < numPages; i++) {
+      Page new_page = file.allocatePage();
+      pid[i] = new_page.page_number();
+      new_page.insertRecord("test.shared parent");
+      file.writePage(new_page);
+    }
+    std::shared_ptr<SharedBufferPool> pool =
+        SharedBufferPool::create(poolName, 8);
+    Page copy;
+    pool->readPage(file, pid[0], copy);
+
+    const pid_t child = fork();
+    if (child == 0) {
+      int status = 0;
+      try {
+        std::shared_ptr<SharedBufferPool> attached =
+            SharedBufferPool::attach(poolName);
+        for (PageId k = 0; k < numPages; k++) {
+          attached->updatePage(file, pid[k], [](Page &shared_page) {
+            shared_page.insertRecord("test.shared child");
+          });
+        }
+      } catch (...) {
+        status = 1;
+      }
+      _exit(status);
+    }
+    int status;
+    if (child < 0 || waitpid(child, &status, 0) != child ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      PRINT_ERROR("ERROR :: CHILD PROCESS FAILED TO UPDATE THE POOL");
+    }
+
+    // Some pages were written back by the child and some are still dirty in
+    // the pool; this process must see all of them.
+    for (i = 0; i < numPages; i++) {
+      pool->readPage(file, pid[i], copy);
+      std::uint32_t records = 0;
+      for (PageIterator iter = copy.begin(); iter != copy.end(); ++iter) {
+        records++;
+      }
+      if (records != 2) {
+        PRINT_ERROR("ERROR :: UPDATE FROM ANOTHER PROCESS WAS NOT SEEN");
+      }
+    }
+    pool->flushFile(file);
+    for (i = 0; i < numPages; i++) {
+      Page on_disk = file.readPage(pid[i]);
+      std::uint32_t records = 0;
+      for (PageIterator iter = on_disk.begin(); iter != on_disk.end();
+           ++iter) {
+        records++;
+      }
+      if (records != 2) {
+        PRINT_ERROR("ERROR :: SHARED PAGE WAS NOT WRITTEN BACK");
+      }
+    }
+  }
+  SharedBufferPool::remove(poolName);
+  File::remove(filename);
+
+  std::cout << "Test 18 passed"
+            << "\n";
+}
+
+void test19() {
+  // Segmented files should read back across segment boundaries, open
+  // segments lazily and remove every segment.  The segment size is not a
+  // multiple of the page size, so some pages straddle two segments.
+  const std::string filename = "test.segmented";
+  StorageOptions options[2];
+  options[0].kind = StorageKind::POSIX;
+  options[1].kind = StorageKind::MEMORY;
+  const PageId numPages = 20;
+  for (StorageOptions &option : options) {
+    option.segmentSize = 3 * Page::SIZE + 100;
+    {
+      File file = File::create(filename, option);
+      BufMgr smallPool(10);
+      for (i = 0; i < numPages; i++) {
+        smallPool.allocPage(file, pid[i], page);
+        sprintf(tmpbuf, "test.segmented Page %" PRIuPAGEID " %7.1f", pid[i],
+                (float)pid[i]);
+        rid[i] = page->insertRecord(tmpbuf);
+        smallPool.unPinPage(file, pid[i], true);
+      }
+      smallPool.flushFile(file);
+    }
+    const std::uint64_t lastSegment =
+        (numPages + 1) * Page::SIZE / option.segmentSize;
+    if (!StorageBackend::exists(
+            SegmentedStorage::segmentName(filename, lastSegment)) ||
+        StorageBackend::exists(
+            SegmentedStorage::segmentName(filename, lastSegment + 1))) {
+      PRINT_ERROR("ERROR :: WRONG NUMBER OF SEGMENTS");
+    }
+    {
+      File file = File::open(filename, option);
+      for (i = 0; i < numPages; i++) {
+        sprintf(tmpbuf, "test.segmented Page %" PRIuPAGEID " %7.1f", pid[i],
+                (float)pid[i]);
+        if (file.readPage(pid[i]).getRecord(rid[i]) != tmpbuf) {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+      }
+    }
+    File::remove(filename, option);
+    if (StorageBackend::exists(SegmentedStorage::segmentName(filename, 1))) {
+      PRINT_ERROR("ERROR :: SEGMENT WAS LEFT BEHIND");
+    }
+  }
+  // Removing a file that is not segmented leaves files named like its
+  // segments alone.
+  File::create(filename);
+  File::create(SegmentedStorage::segmentName(filename, 1));
+  File::remove(filename);
+  if (!File::exists(SegmentedStorage::segmentName(filename, 1))) {
+    PRINT_ERROR("ERROR :: UNRELATED FILE WAS REMOVED");
+  }
+  File::remove(SegmentedStorage::segmentName(filename, 1));
+
+  std::cout << "Test 19 passed"
+            << "\n";
+}
+
+void test20() {
+  // A striped file should spread its pages over every stripe directory and
+  // read them back, including through requests that span stripes.
+  const std::string filename = "test.striped";
+  StorageOptions options;
+  options.stripeDirectories.push_back("test.stripe.a");
+  options.stripeDirectories.push_back("test.stripe.b");
+  options.stripeChunk = Page::SIZE;
+  for (const std::string &directory : options.stripeDirectories) {
+    mkdir(directory.c_str(), 0700);
+  }
+  const PageId numPages = 20;
+  {
+    File file = File::create(filename, options);
+    BufMgr smallPool(30);
+    for (i = 0; i < numPages; i++) {
+      smallPool.allocPage(file, pid[i], page);
+      sprintf(tmpbuf, "test.striped Page %" PRIuPAGEID " %7.1f", pid[i],
+              (float)pid[i]);
+      rid[i] = page->insertRecord(tmpbuf);
+      smallPool.unPinPage(file, pid[i], true);
+    }
+    smallPool.flushFile(file);
+  }
+  for (std::size_t k = 0; k <= options.stripeDirectories.size(); k++) {
+    struct stat status;
+    if (stat(StripedStorage::stripeName(filename, options, k).c_str(),
+             &status) != 0 ||
+        static_cast<std::size_t>(status.st_size) <
+            (numPages / 3) * Page::SIZE) {
+      PRINT_ERROR("ERROR :: PAGES WERE NOT SPREAD OVER THE STRIPES");
+    }
+  }
+  {
+    File file = File::open(filename, options);
+    for (i = 0; i < numPages; i++) {
+      sprintf(tmpbuf, "test.striped Page %" PRIuPAGEID " %7.1f", pid[i],
+              (float)pid[i]);
+      if (file.readPage(pid[i]).getRecord(rid[i]) != tmpbuf) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+    }
+  }
+  File::remove(filename, options);
+  for (const std::string &directory : options.stripeDirectories) {
+    if (rmdir(directory.c_str()) != 0) {
+      PRINT_ERROR("ERROR :: STRIPE WAS LEFT BEHIND");
+    }
+  }
+
+  std::cout << "Test 20 passed"
+            << "\n";
+}
+
+void test21() {
+  // Many open files should share a bounded number of open storages, and
+  // files whose storage was closed should be reopened transparently.
+  const int numFiles = 12;
+  const std::size_t maxOpen = 4;
+  File::setMaxOpenStorage(maxOpen);
+  {
+    std::vector<File> files;
+    BufMgr smallPool(5);
+    for (int k = 0; k < numFiles; k++) {
+      files.push_back(File::create("test.many." + std::to_string(k)));
+      smallPool.allocPage(files.back(), pid[k], page);
+      sprintf(tmpbuf, "test.many %d Page %" PRIuPAGEID, k, pid[k]);
+      rid[k] = page->insertRecord(tmpbuf);
+      smallPool.unPinPage(files.back(), pid[k], true);
+      if (File::openStorageCount() > maxOpen) {
+        PRINT_ERROR("ERROR :: TOO MANY OPEN STORAGES");
+      }
+    }
+    for (int k = 0; k < numFiles; k++) {
+      smallPool.flushFile(files[k]);
+    }
+    for (int k = numFiles - 1; k >= 0; k--) {
+      smallPool.readPage(files[k], pid[k], page);
+      sprintf(tmpbuf, "test.many %d Page %" PRIuPAGEID, k, pid[k]);
+      if (page->getRecord(rid[k]) != tmpbuf) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      smallPool.unPinPage(files[k], pid[k], false);
+    }
+    if (File::openStorageCount() > maxOpen) {
+      PRINT_ERROR("ERROR :: TOO MANY OPEN STORAGES");
+    }
+    for (int k = 0; k < numFiles; k++) {
+      smallPool.flushFile(files[k]);
+    }
+  }
+  for (int k = 0; k < numFiles; k++) {
+    File::remove("test.many." + std::to_string(k));
+  }
+  File::setMaxOpenStorage(512);
+
+  std::cout << "Test 21 passed"
+            << "\n";
+}
+
+void test22() {
+  // Threads copying shared File objects and opening and closing their own
+  // files at the same time should leave the registry consistent.
+  const int numThreads = 8;
+  const int rounds = 200;
+  File shared = File::create("test.registry");
+  for (int k = 0; k < numThreads; k++) {
+    File::create("test.registry." + std::to_string(k));
+  }
+  std::vector<std::thread> threads;
+  for (int k = 0; k < numThreads; k++) {
+    threads.push_back(std::thread([k, &shared]() {
+      const std::string own = "test.registry." + std::to_string(k);
+      for (int round = 0; round < rounds; round++) {
+        std::vector<File> copies(4, shared);
+        File opened = File::open(own);
+        File again = File::open("test.registry");
+        copies.push_back(opened);
+        copies[round % copies.size()] = again;
+      }
+    }));
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  for (int k = 0; k < numThreads; k++) {
+    const std::string own = "test.registry." + std::to_string(k);
+    if (File::isOpen(own)) {
+      PRINT_ERROR("ERROR :: CLOSED FILE IS STILL OPEN");
+    }
+    File::remove(own);
+  }
+  if (!File::isOpen("test.registry")) {
+    PRINT_ERROR("ERROR :: SHARED FILE WAS CLOSED");
+  }
+  shared = File();
+  File::remove("test.registry");
+
+  std::cout << "Test 22 passed"
+            << "\n";
+}
+
+void test23(File &file1) {
+  // Moving a File should hand over its reference without closing the file,
+  // and reading into an existing Page should replace its contents.
+  File copy = file1;
+  File moved = std::move(copy);
+  if (copy.isValid() || !moved.isValid() || moved != file1) {
+    PRINT_ERROR("ERROR :: FILE WAS NOT MOVED");
+  }
+  File &alias = moved;
+  moved = std::move(alias);
+  if (!moved.isValid() || moved != file1) {
+    PRINT_ERROR("ERROR :: SELF-MOVE INVALIDATED THE FILE");
+  }
+  // Dereferencing an iterator reads into the iterator's own page buffer.
+  FileIterator iter = moved.begin();
+  const Page *buffer = &*iter;
+  const PageId first = (*iter).page_number();
+  ++iter;
+  const PageId second = (*iter).page_number();
+  if (&*iter != buffer || first == second) {
+    PRINT_ERROR("ERROR :: ITERATOR DID NOT REUSE ITS PAGE");
+  }
+  Page reused = moved.readPage(first);
+  moved.readPage(second, reused);
+  if (reused.page_number() != second || reused.dirty_sectors() != 0 ||
+      reused.begin() == reused.end() ||
+      *reused.begin() != *moved.readPage(second).begin()) {
+    PRINT_ERROR("ERROR :: PAGE WAS NOT READ INTO THE EXISTING PAGE");
+  }
+  moved = File();
+  if (!File::isOpen(file1.filename())) {
+    PRINT_ERROR("ERROR :: MOVED FILE WAS CLOSED");
+  }
+
+  std::cout << "Test 23 passed"
+            << "\n";
+}
+
+void test24(File &file1) {
+  // The non-throwing variants should report failures as error codes whose
+  // messages match the exceptions the throwing variants raise.
+  Result<Page> missing = file1.tryReadPage(num + 1000);
+  if (missing.ok() || missing.error().code() != ErrorCode::INVALID_PAGE) {
+    PRINT_ERROR("ERROR :: MISSING PAGE WAS READ");
+  }
+  try {
+    file1.readPage(num + 1000);
+    PRINT_ERROR("ERROR :: MISSING PAGE WAS READ");
+  } catch (const InvalidPageException &e) {
+    if (e.message() != missing.error().message()) {
+      PRINT_ERROR("ERROR :: ERROR MESSAGE DOES NOT MATCH EXCEPTION");
+    }
+  }
+
+  const PageId first = (*file1.begin()).page_number();
+  Result<Page> read = file1.tryReadPage(first);
+  if (!read || read.value().page_number() != first) {
+    PRINT_ERROR("ERROR :: EXISTING PAGE WAS NOT READ");
+  }
+  Page &page = read.value();
+  Result<RecordId> inserted = page.tryInsertRecord("try");
+  if (!inserted || page.tryGetRecord(inserted.value()).value() != "try") {
+    PRINT_ERROR("ERROR :: RECORD WAS NOT INSERTED");
+  }
+  Result<RecordId> too_large =
+      page.tryInsertRecord(std::string(Page::SIZE, 'x'));
+  if (too_large || too_large.error().code() != ErrorCode::INSUFFICIENT_SPACE) {
+    PRINT_ERROR("ERROR :: OVERSIZED RECORD WAS INSERTED");
+  }
+  page.deleteRecord(inserted.value());
+  if (page.tryGetRecord(inserted.value()).error().code() !=
+      ErrorCode::INVALID_RECORD) {
+    PRINT_ERROR("ERROR :: DELETED RECORD WAS RETURNED");
+  }
+
+  // An error must stay valid after the File that reported it is closed.
+  Result<Page> orphan = File::create("test.result").tryReadPage(1);
+  if (orphan || File::isOpen("test.result") ||
+      orphan.error().message().find("test.result") == std::string::npos) {
+    PRINT_ERROR("ERROR :: ERROR DID NOT OUTLIVE ITS FILE");
+  }
+  File::remove("test.result");
+
+  std::cout << "Test 24 passed"
+            << "\n";
+}
+
+void test25() {
+  // Deleting pages should let the file shrink: free pages at the end are
+  // cut off, and compaction moves the pages at the end into the free pages
+  // before them.
+  const std::string filename = "test.compact";
+  StorageOptions options[2];
+  options[1].segmentSize = 4 * Page::SIZE;
+  for (const StorageOptions &option : options) {
+    File file = File::create(filename, option);
+    for (i = 0; i < 12; i++) {
+      Page new_page = file.allocatePage();
+      pid[i] = new_page.page_number();
+      sprintf(tmpbuf, "test.compact Page %" PRIuPAGEID, pid[i]);
+      rid[i] = new_page.insertRecord(tmpbuf);
+      file.writePage(new_page);
+    }
+    const int deleted[] = {1, 2, 4, 9, 10, 11};
+    for (const int index : deleted) {
+      file.deletePage(pid[index]);
+      pid[index] = Page::INVALID_NUMBER;
+    }
+    file.reclaimSpace();
+    struct stat status;
+    if (option.segmentSize == 0 &&
+        (stat(filename.c_str(), &status) != 0 ||
+         static_cast<std::uint64_t>(status.st_size) !=
+             sizeof(FileHeader) + pid[8] * Page::SIZE)) {
+      PRINT_ERROR("ERROR :: FREE PAGES AT THE END WERE NOT CUT OFF");
+    }
+
+    const std::map<PageId, PageId> moved = file.compact();
+    if (moved.size() != 3) {
+      PRINT_ERROR("ERROR :: WRONG NUMBER OF PAGES MOVED");
+    }
+    PageId numUsed = 0;
+    for (i = 0; i < 12; i++) {
+      if (pid[i] == Page::INVALID_NUMBER) {
+        continue;
+      }
+      ++numUsed;
+      const std::map<PageId, PageId>::const_iterator found =
+          moved.find(pid[i]);
+      const PageId page_number =
+          found == moved.end() ? pid[i] : found->second;
+      sprintf(tmpbuf, "test.compact Page %" PRIuPAGEID, pid[i]);
+      const RecordId record = {page_number, rid[i].slot_number};
+      if (page_number > 6 ||
+          file.readPage(page_number).getRecord(record) != tmpbuf) {
+        PRINT_ERROR("ERROR :: MOVED PAGE DID NOT KEEP ITS CONTENTS");
+      }
+    }
+    PageId numIterated = 0;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      ++numIterated;
+    }
+    if (numIterated != numUsed || file.allocatePage().page_number() != 7) {
+      PRINT_ERROR("ERROR :: FILE WAS NOT COMPACTED");
+    }
+    if (option.segmentSize == 0
+            ? stat(filename.c_str(), &status) != 0 ||
+                  static_cast<std::uint64_t>(status.st_size) !=
+                      sizeof(FileHeader) + 7 * Page::SIZE
+            : StorageBackend::exists(
+                  SegmentedStorage::segmentName(filename, 2))) {
+      PRINT_ERROR("ERROR :: COMPACTED FILE WAS NOT TRUNCATED");
+    }
+    file = File();
+    File::remove(filename, option);
+  }
+
+  std::cout << "Test 25 passed"
+            << "\n";
+}
+
+void test26() {
+  // Reorganizing should make a full scan read the file sequentially, with
+  // every page keeping its contents under its new number.
+  const std::string filename = "test.reorganize";
+  {
+    File file = File::create(filename);
+    for (i = 0; i < 10; i++) {
+      Page new_page = file.allocatePage();
+      pid[i] = new_page.page_number();
+      sprintf(tmpbuf, "test.reorganize Page %" PRIuPAGEID, pid[i]);
+      rid[i] = new_page.insertRecord(tmpbuf);
+      file.writePage(new_page);
+    }
+    if (file.fragmentation() != 0.0) {
+      PRINT_ERROR("ERROR :: NEW FILE IS FRAGMENTED");
+    }
+    for (i = 1; i < 6; i += 2) {
+      file.deletePage(pid[i]);
+    }
+    // Pages 1, 3, 5, 7, 8, 9 and 10 are left: three of six steps jump.
+    if (file.fragmentation() != 0.5) {
+      PRINT_ERROR("ERROR :: WRONG FRAGMENTATION");
+    }
+    const std::map<PageId, PageId> moved = file.reorganize();
+    if (file.fragmentation() != 0.0 || moved.size() != 6) {
+      PRINT_ERROR("ERROR :: FILE WAS NOT REORGANIZED");
+    }
+    for (i = 0; i < 10; i++) {
+      if (i > 0 && i < 6 && i % 2 == 1) {
+        continue;
+      }
+      const std::map<PageId, PageId>::const_iterator found =
+          moved.find(pid[i]);
+      const RecordId record = {
+          found == moved.end() ? pid[i] : found->second, rid[i].slot_number};
+      sprintf(tmpbuf, "test.reorganize Page %" PRIuPAGEID, pid[i]);
+      if (file.readPage(record.page_number).getRecord(record) != tmpbuf) {
+        PRINT_ERROR("ERROR :: MOVED PAGE DID NOT KEEP ITS CONTENTS");
+      }
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 26 passed"
+            << "\n";
+}
+
+void test27() {
+  // Allocation with a hint should take the free page nearest the related
+  // page, append when the end of the file is nearer than any free page, and
+  // keep the used list in ascending order.
+  const std::string filename = "test.locality";
+  {
+    File file = File::create(filename);
+    for (i = 0; i < 20; i++) {
+      file.allocatePage();
+    }
+    file.deletePage(3);
+    file.deletePage(10);
+    file.deletePage(17);
+    if (file.allocatePage(9).page_number() != 10 ||
+        file.allocatePage(2).page_number() != 3 ||
+        file.allocatePage(200).page_number() != 21 ||
+        file.allocatePage(19).page_number() != 17) {
+      PRINT_ERROR("ERROR :: PAGE WAS NOT ALLOCATED NEAR THE HINT");
+    }
+    file.deletePage(12);
+    {
+      BufMgr smallPool(4);
+      Page *hinted;
+      PageId hintedNo;
+      smallPool.allocPage(file, 11, hintedNo, hinted);
+      if (hintedNo != 12) {
+        PRINT_ERROR("ERROR :: BUFFER MANAGER IGNORED THE HINT");
+      }
+      smallPool.unPinPage(file, hintedNo, true);
+      smallPool.flushFile(file);
+    }
+    PageId previous = Page::INVALID_NUMBER;
+    PageId numPages = 0;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      if ((*iter).page_number() <= previous) {
+        PRINT_ERROR("ERROR :: USED LIST IS OUT OF ORDER");
+      }
+      previous = (*iter).page_number();
+      ++numPages;
+    }
+    if (numPages != 21) {
+      PRINT_ERROR("ERROR :: WRONG NUMBER OF PAGES");
+    }
+
+    // A free page reused into an empty used list must not keep its link to
+    // the next free page.
+    for (PageId page_number = 1; page_number <= 21; ++page_number) {
+      file.deletePage(page_number);
+    }
+    file.allocatePage();
+    numPages = 0;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      ++numPages;
+    }
+    if (numPages != 1) {
+      PRINT_ERROR("ERROR :: REUSED PAGE KEPT ITS FREE LIST LINK");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 27 passed"
+            << "\n";
+}
+
+void test28() {
+  // A snapshot should include pages still dirty in the buffer pool, and
+  // stay unchanged when the original is modified afterwards.
+  const std::string filename = "test.original";
+  const std::string snapshotName = "test.snapshot";
+  StorageOptions options[3];
+  options[1].kind = StorageKind::MEMORY;
+  options[2].segmentSize = 3 * Page::SIZE;
+  for (const StorageOptions &option : options) {
+    {
+      File file = File::create(filename, option);
+      BufMgr smallPool(10);
+      for (i = 0; i < 8; i++) {
+        smallPool.allocPage(file, pid[i], page);
+        sprintf(tmpbuf, "test.snapshot Page %" PRIuPAGEID, pid[i]);
+        rid[i] = page->insertRecord(tmpbuf);
+        smallPool.unPinPage(file, pid[i], true);
+      }
+      smallPool.snapshotFile(file, snapshotName);
+      try {
+        smallPool.snapshotFile(file, snapshotName);
+        PRINT_ERROR("ERROR :: SNAPSHOT WAS OVERWRITTEN");
+      } catch (const FileExistsException &) {
+      }
+      smallPool.readPage(file, pid[0], page);
+      page->updateRecord(rid[0], "changed after the snapshot");
+      smallPool.unPinPage(file, pid[0], true);
+      smallPool.flushFile(file);
+    }
+    {
+      File snapshot = File::open(snapshotName, option);
+      for (i = 0; i < 8; i++) {
+        sprintf(tmpbuf, "test.snapshot Page %" PRIuPAGEID, pid[i]);
+        if (snapshot.readPage(pid[i]).getRecord(rid[i]) != tmpbuf) {
+          PRINT_ERROR("ERROR :: SNAPSHOT DID NOT MATCH THE ORIGINAL");
+        }
+      }
+    }
+    File::remove(filename, option);
+    File::remove(snapshotName, option);
+  }
+
+  std::cout << "Test 28 passed"
+            << "\n";
+}
+
+void test29() {
+  // Only pages written since the last backup should be streamed, and
+  // applying them to a snapshot should reproduce the original.
+  const std::string filename = "test.tracked";
+  const std::string baseName = "test.base";
+  StorageOptions options[2];
+  options[1].kind = StorageKind::MEMORY;
+  for (const StorageOptions &option : options) {
+    {
+      File file = File::create(filename, option);
+      BufMgr smallPool(10);
+      for (i = 0; i < 8; i++) {
+        smallPool.allocPage(file, pid[i], page);
+        sprintf(tmpbuf, "test.tracked Page %" PRIuPAGEID, pid[i]);
+        rid[i] = page->insertRecord(tmpbuf);
+        smallPool.unPinPage(file, pid[i], true);
+      }
+      smallPool.flushFile(file);
+      file.trackChanges();
+      file.snapshot(baseName);
+      for (const int changed : {1, 2, 5}) {
+        smallPool.readPage(file, pid[changed], page);
+        page->updateRecord(rid[changed], "changed after the base");
+        smallPool.unPinPage(file, pid[changed], true);
+      }
+      smallPool.flushFile(file);
+    }
+    std::stringstream changes;
+    std::stringstream later;
+    {
+      // Tracking continues after the file is reopened.
+      File file = File::open(filename, option);
+      Page changed = file.readPage(pid[6]);
+      changed.updateRecord(rid[6], "changed after reopening");
+      file.writePage(changed);
+      std::stringstream lost;
+      if (file.backupChanges(lost) != 4) {
+        PRINT_ERROR("ERROR :: WRONG NUMBER OF CHANGED PAGES");
+      }
+    }
+    {
+      // A backup that was never committed is repeated in full, and pages
+      // written before the commit stay marked.
+      File file = File::open(filename, option);
+      if (file.backupChanges(changes) != 4) {
+        PRINT_ERROR("ERROR :: UNCOMMITTED BACKUP WAS NOT REPEATED");
+      }
+      Page changed = file.readPage(pid[1]);
+      changed.updateRecord(rid[1], "changed during the backup");
+      file.writePage(changed);
+      file.commitBackup();
+      if (file.backupChanges(later) != 1) {
+        PRINT_ERROR("ERROR :: WRONG PAGES STAYED MARKED AFTER A BACKUP");
+      }
+      file.commitBackup();
+      std::stringstream none;
+      if (file.backupChanges(none) != 0) {
+        PRINT_ERROR("ERROR :: PAGES STAYED MARKED AFTER A BACKUP");
+      }
+    }
+    {
+      File base = File::open(baseName, option);
+      try {
+        std::stringstream none;
+        base.backupChanges(none);
+        PRINT_ERROR("ERROR :: UNTRACKED FILE WAS BACKED UP");
+      } catch (const IoException &) {
+      }
+      base.applyChanges(changes);
+      base.applyChanges(later);
+      File file = File::open(filename, option);
+      for (i = 0; i < 8; i++) {
+        if (base.readPage(pid[i]).getRecord(rid[i]) !=
+            file.readPage(pid[i]).getRecord(rid[i])) {
+          PRINT_ERROR("ERROR :: RESTORED FILE DID NOT MATCH THE ORIGINAL");
+        }
+      }
+    }
+    File::remove(filename);
+    File::remove(baseName);
+  }
+
+  std::cout << "Test 29 passed"
+            << "\n";
+}
+
+void test30() {
+  // A miss on one file should not wait for a slow write-back of another.
+  const std::string slowName = "test.slow";
+  const std::string fastName = "test.fast";
+  StorageOptions slowOption;
+  slowOption.kind = StorageKind::MEMORY;
+  slowOption.writeLatency = std::chrono::milliseconds(300);
+  StorageOptions fastOption;
+  fastOption.kind = StorageKind::MEMORY;
+  {
+    File slow = File::create(slowName, slowOption);
+    File fast = File::create(fastName, fastOption);
+    BufMgr smallPool(4);
+    PageId slowPage, fastPage;
+    smallPool.allocPage(fast, fastPage, page);
+    smallPool.unPinPage(fast, fastPage, true);
+    smallPool.flushFile(fast);
+    smallPool.allocPage(slow, slowPage, page);
+    page->insertRecord("test.slow");
+    smallPool.unPinPage(slow, slowPage, true);
+
+    std::thread flusher([&smallPool, &slow]() { smallPool.flushFile(slow); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const auto start = std::chrono::steady_clock::now();
+    smallPool.readPage(fast, fastPage, page);
+    const auto waited = std::chrono::steady_clock::now() - start;
+    smallPool.unPinPage(fast, fastPage, false);
+    flusher.join();
+    if (waited > std::chrono::milliseconds(150)) {
+      PRINT_ERROR("ERROR :: MISS WAITED FOR ANOTHER FILE'S WRITE-BACK");
+    }
+  }
+  File::remove(slowName);
+  File::remove(fastName);
+
+  std::cout << "Test 30 passed"
+            << "\n";
+}
+
+void test31() {
+  // Allocating a page must not write out other callers' reservations, and a
+  // deferred allocation that fails must not leave its reservation behind.
+  const std::string name = "test.reserve";
+  StorageOptions options;
+  options.kind = StorageKind::MEMORY;
+  {
+    File file = File::create(name, options);
+    BufMgr smallPool(3);
+    PageId reserved1, reserved2, appended;
+    smallPool.allocPage(file, reserved1, page, true /* deferred */);
+    rid2 = page->insertRecord("test.reserve deferred");
+    smallPool.unPinPage(file, reserved1, true);
+    smallPool.allocPage(file, reserved2, page, true /* deferred */);
+    smallPool.unPinPage(file, reserved2, true);
+    smallPool.allocPage(file, appended, page);
+    smallPool.unPinPage(file, appended, true);
+    std::uint32_t used = 0;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      used++;
+    }
+    if (appended <= reserved2 || used != 1) {
+      PRINT_ERROR("ERROR :: ALLOCATION COMMITTED OTHER RESERVATIONS");
+    }
+    try {
+      file.readPage(reserved1);
+      PRINT_ERROR("ERROR :: UNWRITTEN RESERVED PAGE WAS READ");
+    } catch (const InvalidPageException &) {
+    }
+
+    smallPool.flushFile(file);
+    PageId previous = Page::INVALID_NUMBER;
+    used = 0;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      if (iter.page_number() <= previous) {
+        PRINT_ERROR("ERROR :: COMMITTED PAGES ARE OUT OF ORDER");
+      }
+      previous = iter.page_number();
+      used++;
+    }
+    if (used != 3 ||
+        file.readPage(reserved1).getRecord(rid2) != "test.reserve deferred") {
+      PRINT_ERROR("ERROR :: RESERVED PAGES WERE NOT COMMITTED");
+    }
+
+    // Every frame is pinned, so the deferred allocation fails.
+    smallPool.readPage(file, reserved1, page);
+    smallPool.readPage(file, reserved2, page);
+    smallPool.readPage(file, appended, page);
+    try {
+      smallPool.allocPage(file, pageno1, page, true /* deferred */);
+      PRINT_ERROR("ERROR :: DEFERRED ALLOCATION DID NOT FAIL");
+    } catch (const BufferExceededException &) {
+    }
+    smallPool.unPinPage(file, reserved1, false);
+    smallPool.unPinPage(file, reserved2, false);
+    smallPool.unPinPage(file, appended, false);
+    smallPool.allocPage(file, pageno1, page, true /* deferred */);
+    smallPool.unPinPage(file, pageno1, true);
+    smallPool.flushFile(file);
+    used = 0;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      used++;
+    }
+    if (used != 4 || pageno1 != appended + 1) {
+      PRINT_ERROR("ERROR :: FAILED DEFERRED ALLOCATION LEFT A PAGE BEHIND");
+    }
+
+    // A reservation the file grew past goes on the free list when dropped.
+    smallPool.allocPage(file, pageno2, page, true /* deferred */);
+    smallPool.unPinPage(file, pageno2, true);
+    smallPool.allocPage(file, pageno3, page);
+    smallPool.unPinPage(file, pageno3, true);
+    smallPool.disposePage(file, pageno2);
+    smallPool.allocPage(file, pageno1, page);
+    smallPool.unPinPage(file, pageno1, true);
+    if (pageno3 <= pageno2 || pageno1 != pageno2) {
+      PRINT_ERROR("ERROR :: DROPPED RESERVATION WAS NOT FREED");
+    }
+    smallPool.flushFile(file);
+  }
+  File::remove(name, options);
+
+  std::cout << "Test 31 passed"
+            << "\n";
+}
+
+void test32() {
+  // Threads that miss the same page at once should share a single read.
+  const std::string name = "test.singleflight";
+  const int numThreads = 8;
+  StorageOptions options;
+  options.kind = StorageKind::MEMORY;
+  options.readLatency = std::chrono::milliseconds(100);
+  {
+    File file = File::create(name, options);
+    Page onDisk = file.allocatePage();
+    const RecordId record = onDisk.insertRecord("test.singleflight");
+    file.writePage(onDisk);
+    const PageId shared = onDisk.page_number();
+
+    BufMgr smallPool(4);
+    std::vector<std::string> seen(numThreads);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < numThreads; t++) {
+      readers.emplace_back([&smallPool, &file, &seen, record, shared, t]() {
+        Page *mine;
+        smallPool.readPage(file, shared, mine);
+        seen[t] = mine->getRecord(record);
+        smallPool.unPinPage(file, shared, false);
+      });
+    }
+    for (std::thread &reader : readers) {
+      reader.join();
+    }
+    if (smallPool.getBufStats().diskreads != 1) {
+      PRINT_ERROR("ERROR :: CONCURRENT MISSES READ THE PAGE MORE THAN ONCE");
+    }
+    for (const std::string &contents : seen) {
+      if (contents != "test.singleflight") {
+        PRINT_ERROR("ERROR :: CONCURRENT MISSES SAW DIFFERENT CONTENTS");
+      }
+    }
+  }
+  File::remove(name, options);
+
+  std::cout << "Test 32 passed"
+            << "\n";
+}
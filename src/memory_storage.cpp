@@ -0,0 +1,101 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "memory_storage.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "exceptions/io_exception.h"
+
+namespace badgerdb {
+
+MemoryStorage::Registry MemoryStorage::registry_;
+std::mutex MemoryStorage::registryMutex_;
+
+MemoryStorage::MemoryStorage(const std::string &name, const bool create,
+                             const bool temporary) {
+  if (temporary) {
+    contents_ = std::make_shared<Contents>();
+    return;
+  }
+  std::lock_guard<std::mutex> lock(registryMutex_);
+  if (create) {
+    contents_ = std::make_shared<Contents>();
+    registry_[name] = contents_;
+    return;
+  }
+  Registry::const_iterator existing = registry_.find(name);
+  if (existing == registry_.end()) {
+    throw IoException(name, "open", ENOENT);
+  }
+  contents_ = existing->second;
+}
+
+bool MemoryStorage::exists(const std::string &name) {
+  std::lock_guard<std::mutex> lock(registryMutex_);
+  return registry_.find(name) != registry_.end();
+}
+
+bool MemoryStorage::remove(const std::string &name) {
+  std::lock_guard<std::mutex> lock(registryMutex_);
+  return registry_.erase(name) > 0;
+}
+
+void MemoryStorage::read(const std::uint64_t offset, char *data,
+                         const std::size_t length) {
+  std::lock_guard<std::mutex> lock(contents_->mutex);
+  const std::vector<char> &bytes = contents_->bytes;
+  const std::uint64_t available =
+      offset < bytes.size()
+          ? std::min<std::uint64_t>(length, bytes.size() - offset)
+          : 0;
+  if (available > 0) {
+    std::memcpy(data, bytes.data() + offset, available);
+  }
+  std::memset(data + available, 0, length - available);
+}
+
+void MemoryStorage::write(const std::uint64_t offset, const char *data,
+                          const std::size_t length) {
+  std::lock_guard<std::mutex> lock(contents_->mutex);
+  std::vector<char> &bytes = contents_->bytes;
+  if (offset + length > bytes.size()) {
+    bytes.resize(offset + length);
+  }
+  std::memcpy(bytes.data() + offset, data, length);
+}
+
+std::uint64_t MemoryStorage::size() {
+  std::lock_guard<std::mutex> lock(contents_->mutex);
+  return contents_->bytes.size();
+}
+
+void MemoryStorage::snapshot(const std::string &name) {
+  std::shared_ptr<Contents> copy = std::make_shared<Contents>();
+  {
+    std::lock_guard<std::mutex> lock(contents_->mutex);
+    copy->bytes = contents_->bytes;
+  }
+  std::lock_guard<std::mutex> lock(registryMutex_);
+  if (!registry_.insert(std::make_pair(name, copy)).second) {
+    throw IoException(name, "create", EEXIST);
+  }
+}
+
+void MemoryStorage::truncate(const std::uint64_t size) {
+  std::lock_guard<std::mutex> lock(contents_->mutex);
+  std::vector<char> &bytes = contents_->bytes;
+  if (size < bytes.size()) {
+    bytes.resize(size);
+    bytes.shrink_to_fit();
+  }
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,95 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "storage_backend.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Storage in process memory.
+ *
+ * Contents are kept in a registry by name, so that a file can be closed and
+ * opened again, until it is removed.  Useful for tests and for benchmarking
+ * without disk noise.
+ */
+class MemoryStorage : public StorageBackend {
+ public:
+  /**
+   * Opens the named contents.
+   *
+   * @param name    Name of the file.
+   * @param create  Whether to start with empty contents.
+   * @param temporary Whether to keep the contents out of the registry, so
+   *                  that they are discarded with this object.
+   * @throws  IoException  If create is false and no contents exist under
+   *                       the name.
+   */
+  MemoryStorage(const std::string &name, const bool create,
+                const bool temporary = false);
+
+  /**
+   * Returns whether contents exist under the given name.
+   *
+   * @param name  Name of the file.
+   */
+  static bool exists(const std::string &name);
+
+  /**
+   * Discards the contents with the given name.
+   *
+   * @param name  Name of the file.
+   * @return  Whether contents existed under the name.
+   */
+  static bool remove(const std::string &name);
+
+  void read(const std::uint64_t offset, char *data,
+            const std::size_t length) override;
+  void write(const std::uint64_t offset, const char *data,
+             const std::size_t length) override;
+  void sync() override {}
+  std::uint64_t size() override;
+  void truncate(const std::uint64_t size) override;
+  void snapshot(const std::string &name) override;
+
+ private:
+  /**
+   * @brief Contents of one file.
+   */
+  struct Contents {
+    std::mutex mutex;
+    std::vector<char> bytes;
+  };
+
+  typedef std::map<std::string, std::shared_ptr<Contents>> Registry;
+
+  /**
+   * Contents of every file, by name.
+   */
+  static Registry registry_;
+
+  /**
+   * Guards registry_.
+   */
+  static std::mutex registryMutex_;
+
+  /**
+   * Contents of this file.
+   */
+  std::shared_ptr<Contents> contents_;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,150 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "mmap_storage.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "exceptions/io_exception.h"
+#include "posix_storage.h"
+
+namespace badgerdb {
+
+const std::size_t MmapStorage::MIN_MAPPING;
+
+MmapStorage::MmapStorage(const std::string &name, const bool create,
+                          const bool temporary)
+    : name_(name), base_(nullptr), mapped_(0), size_(0) {
+  fd_ = ::open(name.c_str(),
+               O_RDWR | O_CREAT | (create || temporary ? O_TRUNC : 0), 0644);
+  if (fd_ < 0) {
+    throw IoException(name_, "open", errno);
+  }
+  if (temporary) {
+    // The descriptor keeps the file alive; the kernel reclaims it on close.
+    ::unlink(name.c_str());
+  }
+  struct stat status;
+  if (::fstat(fd_, &status) != 0) {
+    const int error = errno;
+    ::close(fd_);
+    throw IoException(name_, "stat", error);
+  }
+  size_ = status.st_size;
+  try {
+    remap(size_);
+  } catch (...) {
+    ::close(fd_);
+    throw;
+  }
+}
+
+MmapStorage::~MmapStorage() {
+  ::munmap(base_, mapped_);
+  ::close(fd_);
+}
+
+void MmapStorage::read(const std::uint64_t offset, char *data,
+                       const std::size_t length) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const std::uint64_t available =
+      offset < size_ ? std::min<std::uint64_t>(length, size_ - offset) : 0;
+  if (available > 0) {
+    std::memcpy(data, base_ + offset, available);
+  }
+  std::memset(data + available, 0, length - available);
+}
+
+void MmapStorage::write(const std::uint64_t offset, const char *data,
+                        const std::size_t length) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const std::uint64_t end = offset + length;
+  if (end > size_) {
+    if (::ftruncate(fd_, end) != 0) {
+      throw IoException(name_, "extend", errno);
+    }
+    size_ = end;
+    if (end > mapped_) {
+      remap(std::max<std::uint64_t>(end, 2 * mapped_));
+    }
+  }
+  std::memcpy(base_ + offset, data, length);
+}
+
+void MmapStorage::sync() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (::msync(base_, size_, MS_SYNC) != 0) {
+    throw IoException(name_, "sync", errno);
+  }
+}
+
+std::uint64_t MmapStorage::size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+void MmapStorage::punchHole(const std::uint64_t offset,
+                            const std::uint64_t length) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (offset >= size_) {
+    return;
+  }
+  const std::uint64_t punched = std::min(length, size_ - offset);
+  if (::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset,
+                  punched) == 0) {
+    return;
+  }
+  if (errno != EOPNOTSUPP) {
+    throw IoException(name_, "punch hole", errno);
+  }
+  // The filesystem cannot release the space; just zero the range.
+  std::memset(base_ + offset, 0, punched);
+}
+
+void MmapStorage::truncate(const std::uint64_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (size >= size_) {
+    return;
+  }
+  // The mapping is left as it is; nothing past size_ is accessed.
+  if (::ftruncate(fd_, size) != 0) {
+    throw IoException(name_, "truncate", errno);
+  }
+  size_ = size;
+}
+
+void MmapStorage::snapshot(const std::string &name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Writes through the mapping are in the page cache, which both the clone
+  // and the copy read from.
+  PosixStorage::copyFile(fd_, size_, name);
+}
+
+void MmapStorage::remap(const std::uint64_t capacity) {
+  const std::uint64_t length =
+      std::max<std::uint64_t>(capacity, MIN_MAPPING);
+  void *base =
+      ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (base == MAP_FAILED) {
+    throw IoException(name_, "map", errno);
+  }
+  if (base_ != nullptr) {
+    ::munmap(base_, mapped_);
+  }
+  base_ = static_cast<char *>(base);
+  mapped_ = length;
+}
+
+}  // namespace badgerdb
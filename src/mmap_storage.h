@@ -0,0 +1,105 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "storage_backend.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Storage in a filesystem file, accessed through a shared memory
+ * mapping.
+ *
+ * Requests are plain memory copies.  The mapping is reserved with room to
+ * grow; when a write extends the file past it, the file is remapped with
+ * twice the room.  Requests are serialized so that none sees the mapping
+ * move underneath it.
+ */
+class MmapStorage : public StorageBackend {
+ public:
+  /**
+   * Opens and maps the file, creating it if it does not exist.
+   *
+   * @param name    Name of the file.
+   * @param create  Whether to truncate the file.
+   * @param temporary Whether to unlink the file once it is open.
+   * @throws  IoException  If the file cannot be opened or mapped.
+   */
+  MmapStorage(const std::string &name, const bool create,
+              const bool temporary = false);
+
+  MmapStorage(const MmapStorage &) = delete;
+  MmapStorage &operator=(const MmapStorage &) = delete;
+
+  /**
+   * Unmaps and closes the file.
+   */
+  ~MmapStorage();
+
+  void read(const std::uint64_t offset, char *data,
+            const std::size_t length) override;
+  void write(const std::uint64_t offset, const char *data,
+             const std::size_t length) override;
+  void sync() override;
+  std::uint64_t size() override;
+  void punchHole(const std::uint64_t offset,
+                 const std::uint64_t length) override;
+  void truncate(const std::uint64_t size) override;
+  void snapshot(const std::string &name) override;
+
+ private:
+  /**
+   * Smallest mapping.
+   */
+  static const std::size_t MIN_MAPPING = 1 << 20;
+
+  /**
+   * Maps the file with room for at least the given size.  Caller must hold
+   * mutex_.
+   *
+   * @param capacity  Bytes the mapping must cover.
+   */
+  void remap(const std::uint64_t capacity);
+
+  /**
+   * Name of the file, for error messages.
+   */
+  std::string name_;
+
+  /**
+   * File descriptor.
+   */
+  int fd_;
+
+  /**
+   * Start of the mapping.
+   */
+  char *base_;
+
+  /**
+   * Length of the mapping.
+   */
+  std::uint64_t mapped_;
+
+  /**
+   * Size of the file.
+   */
+  std::uint64_t size_;
+
+  /**
+   * Serializes requests.
+   */
+  std::mutex mutex_;
+};
+
+}  // namespace badgerdb
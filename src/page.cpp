@@ -28,20 +28,31 @@ void Page::initialize() {
   header_.current_page_number = INVALID_NUMBER;
   header_.next_page_number = INVALID_NUMBER;
   data_.assign(DATA_SIZE, char());
+  dirty_sectors_ = 0;
 }
 
 RecordId Page::insertRecord(const std::string &record_data) {
+  return tryInsertRecord(record_data).valueOrThrow();
+}
+
+Result<RecordId> Page::tryInsertRecord(const std::string &record_data) {
   if (!hasSpaceForRecord(record_data)) {
-    throw InsufficientSpaceException(page_number(), record_data.length(),
-                                     getFreeSpace());
+    return Error::insufficientSpace(page_number(), record_data.length(),
+                                    getFreeSpace());
   }
   const SlotId slot_number = getAvailableSlot();
   insertRecordInSlot(slot_number, record_data);
-  return {page_number(), slot_number};
+  return RecordId{page_number(), slot_number};
 }
 
 std::string Page::getRecord(const RecordId &record_id) const {
-  validateRecordId(record_id);
+  return tryGetRecord(record_id).valueOrThrow();
+}
+
+Result<std::string> Page::tryGetRecord(const RecordId &record_id) const {
+  if (!isValidRecordId(record_id)) {
+    return Error::invalidRecord(record_id, page_number());
+  }
   const PageSlot *slot = getSlot(record_id.slot_number);
   return data_.substr(slot->item_offset, slot->item_length);
 }
@@ -72,6 +83,10 @@ void Page::deleteRecord(const RecordId &record_id,
   validateRecordId(record_id);
   PageSlot *slot = getSlot(record_id.slot_number);
   data_.replace(slot->item_offset, slot->item_length, slot->item_length, '\0');
+  markDirty(slot->item_offset, slot->item_length);
+  markHeaderDirty();
+  // Moving records below rewrites their slots anywhere in the slot array.
+  markDirty(0, sizeof(PageSlot) * header_.num_slots);
 
   // Compact the data by removing the hole left by this record (if necessary).
   std::uint16_t move_offset = slot->item_offset;
@@ -92,6 +107,7 @@ void Page::deleteRecord(const RecordId &record_id,
   if (move_bytes > 0) {
     const std::string &data_to_move = data_.substr(move_offset, move_bytes);
     data_.replace(move_offset + slot->item_length, move_bytes, data_to_move);
+    markDirty(move_offset, move_bytes + slot->item_length);
   }
   header_.free_space_upper_bound += slot->item_length;
 
@@ -159,6 +175,7 @@ SlotId Page::getAvailableSlot() {
     ++header_.num_slots;
     ++header_.num_free_slots;
     header_.free_space_lower_bound = sizeof(PageSlot) * header_.num_slots;
+    markHeaderDirty();
   }
   assert(slot_number != INVALID_SLOT);
   return slot_number;
@@ -180,18 +197,22 @@ void Page::insertRecordInSlot(const SlotId slot_number,
   header_.free_space_upper_bound = slot->item_offset;
   --header_.num_free_slots;
   data_.replace(slot->item_offset, slot->item_length, record_data);
+  markHeaderDirty();
+  markDirty((slot_number - 1) * sizeof(PageSlot), sizeof(PageSlot));
+  markDirty(slot->item_offset, slot->item_length);
 }
 
 void Page::validateRecordId(const RecordId &record_id) const {
-  if (record_id.page_number != page_number()) {
-    throw InvalidRecordException(record_id, page_number());
-  }
-  const PageSlot *slot = getSlot(record_id.slot_number);
-  if (!slot->used) {
+  if (!isValidRecordId(record_id)) {
     throw InvalidRecordException(record_id, page_number());
   }
 }
 
+bool Page::isValidRecordId(const RecordId &record_id) const {
+  return record_id.page_number == page_number() &&
+         getSlot(record_id.slot_number)->used;
+}
+
 PageIterator Page::begin() { return PageIterator(this); }
 
 PageIterator Page::end() {
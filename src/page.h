@@ -14,6 +14,7 @@
 #include <memory>
 #include <string>
 
+#include "result.h"
 #include "types.h"
 
 namespace badgerdb {
@@ -118,6 +119,11 @@ class Page {
    */
   static const std::size_t DATA_SIZE = SIZE - sizeof(PageHeader);
 
+  /**
+   * Granularity, in bytes, at which modifications to the page are tracked.
+   */
+  static const std::size_t SECTOR_SIZE = 512;
+
   /**
    * Number of page indicating that it's invalid.
    */
@@ -141,6 +147,16 @@ class Page {
    */
   RecordId insertRecord(const std::string &record_data);
 
+  /**
+   * Inserts a new record into the page like insertRecord(), but reports a
+   * page without enough space as an INSUFFICIENT_SPACE error instead of
+   * throwing.
+   *
+   * @param record_data  Bytes that compose the record.
+   * @return  ID of the newly inserted record, or the error.
+   */
+  Result<RecordId> tryInsertRecord(const std::string &record_data);
+
   /**
    * Returns the record with the given ID.  Returned data is a copy of what is
    * stored on the page; use updateRecord to change it.
@@ -151,6 +167,16 @@ class Page {
    */
   std::string getRecord(const RecordId &record_id) const;
 
+  /**
+   * Returns the record with the given ID like getRecord(), but reports a
+   * record that is not on the page as an INVALID_RECORD error instead of
+   * throwing.
+   *
+   * @param record_id  ID of the record to return.
+   * @return  The record, or the error.
+   */
+  Result<std::string> tryGetRecord(const RecordId &record_id) const;
+
   /**
    * Updates the record with the given ID, replacing its data with a new
    * version.  This is equivalent to deleting the old record and inserting a
@@ -201,6 +227,15 @@ class Page {
    */
   PageId next_page_number() const { return header_.next_page_number; }
 
+  /**
+   * Returns which sectors of the page image (header followed by data) were
+   * modified since the page was read from or last written to its file.  Bit i
+   * stands for bytes [i * SECTOR_SIZE, (i + 1) * SECTOR_SIZE).
+   *
+   * @return  Bitmap of modified sectors.
+   */
+  std::uint32_t dirty_sectors() const { return dirty_sectors_; }
+
   /**
    * Returns an iterator at the first record in the page.
    *
@@ -315,6 +350,38 @@ class Page {
    */
   void validateRecordId(const RecordId &record_id) const;
 
+  /**
+   * Returns whether the given record ID is valid for this page.
+   *
+   * @param record_id   Record ID to check.
+   * @return  Whether the ID has the right page number and references a slot
+   *          in use.
+   */
+  bool isValidRecordId(const RecordId &record_id) const;
+
+  /**
+   * Records that the given range of the page's data was modified.
+   *
+   * @param offset  Offset of the range in the data.
+   * @param length  Length of the range.
+   */
+  void markDirty(const std::size_t offset, const std::size_t length) {
+    if (length == 0) {
+      return;
+    }
+    const std::size_t first = (sizeof(PageHeader) + offset) / SECTOR_SIZE;
+    const std::size_t last =
+        (sizeof(PageHeader) + offset + length - 1) / SECTOR_SIZE;
+    for (std::size_t sector = first; sector <= last; ++sector) {
+      dirty_sectors_ |= 1u << sector;
+    }
+  }
+
+  /**
+   * Records that the page header was modified.
+   */
+  void markHeaderDirty() { dirty_sectors_ |= 1u; }
+
   /**
    * Returns whether the page is in use or is a free page.
    *
@@ -334,7 +401,16 @@ class Page {
 
   std::string data_;
 
+  /**
+   * Sectors modified since the page was read or written; see dirty_sectors().
+   * Cleared by File when the page is written, hence mutable.
+   */
+  mutable std::uint32_t dirty_sectors_;
+
   friend class File;
+  friend class CompressedCache;
+  friend class SecondaryCache;
+  friend class SharedBufferPool;
   friend class PageIterator;
   friend class PageTest;
   friend class BufferTest;
@@ -343,5 +419,10 @@ class Page {
 static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
 static_assert(Page::DATA_SIZE > 0, "Page must have some space to hold data.");
+static_assert(sizeof(PageHeader) <= Page::SECTOR_SIZE,
+              "Page header must fit in the first sector.");
+static_assert(Page::SIZE % Page::SECTOR_SIZE == 0 &&
+                  Page::SIZE / Page::SECTOR_SIZE <= 32,
+              "Page must consist of at most 32 whole sectors.");
 
 }  // namespace badgerdb
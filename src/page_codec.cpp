@@ -0,0 +1,168 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "page_codec.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace badgerdb {
+
+const std::size_t PageCodec::MIN_MATCH;
+const std::size_t PageCodec::MAX_OFFSET;
+const int PageCodec::HASH_BITS;
+
+namespace {
+
+inline std::uint32_t read32(const char *p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+/**
+ * Appends a length that did not fit in its token nibble as 255-byte
+ * continuation bytes.  Returns false if dst runs out.
+ */
+inline bool putLength(std::size_t length, char *dst, std::size_t &out,
+                      const std::size_t capacity) {
+  while (length >= 255) {
+    if (out >= capacity) return false;
+    dst[out++] = static_cast<char>(255);
+    length -= 255;
+  }
+  if (out >= capacity) return false;
+  dst[out++] = static_cast<char>(length);
+  return true;
+}
+
+/**
+ * Reads a length continued past its token nibble.  Returns false if src runs
+ * out.
+ */
+inline bool getLength(const unsigned char *src, std::size_t &in,
+                      const std::size_t length, std::size_t &value) {
+  unsigned char byte;
+  do {
+    if (in >= length) return false;
+    byte = src[in++];
+    value += byte;
+  } while (byte == 255);
+  return true;
+}
+
+/**
+ * Appends one sequence.  A match length of 0 marks the final, literal-only
+ * sequence.  Returns false if dst runs out.
+ */
+bool putSequence(const char *literals, const std::size_t literalLength,
+                 const std::size_t offset, const std::size_t matchLength,
+                 const std::size_t minMatch, char *dst, std::size_t &out,
+                 const std::size_t capacity) {
+  const std::size_t matchCode = matchLength == 0 ? 0 : matchLength - minMatch;
+  if (out >= capacity) return false;
+  const std::size_t token = out++;
+  dst[token] = static_cast<char>(
+      ((literalLength < 15 ? literalLength : 15) << 4) |
+      (matchCode < 15 ? matchCode : 15));
+  if (literalLength >= 15 &&
+      !putLength(literalLength - 15, dst, out, capacity)) {
+    return false;
+  }
+  if (out + literalLength > capacity) return false;
+  std::memcpy(dst + out, literals, literalLength);
+  out += literalLength;
+  if (matchLength == 0) {
+    return true;
+  }
+  if (out + 2 > capacity) return false;
+  dst[out++] = static_cast<char>(offset & 0xff);
+  dst[out++] = static_cast<char>(offset >> 8);
+  return matchCode < 15 || putLength(matchCode - 15, dst, out, capacity);
+}
+
+}  // namespace
+
+std::size_t PageCodec::compress(const char *src, const std::size_t length,
+                                char *dst, const std::size_t capacity) {
+  // Positions are stored plus one, so that zero means "empty".
+  std::uint32_t table[1 << HASH_BITS] = {};
+  std::size_t out = 0;
+  std::size_t anchor = 0;
+  std::size_t pos = 0;
+  while (pos + MIN_MATCH <= length) {
+    const std::uint32_t sequence = read32(src + pos);
+    const std::uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+    const std::size_t candidate = table[hash];
+    table[hash] = static_cast<std::uint32_t>(pos + 1);
+    if (candidate == 0 || pos - (candidate - 1) > MAX_OFFSET ||
+        read32(src + candidate - 1) != sequence) {
+      ++pos;
+      continue;
+    }
+    const std::size_t match = candidate - 1;
+    std::size_t matchLength = MIN_MATCH;
+    while (pos + matchLength < length &&
+           src[match + matchLength] == src[pos + matchLength]) {
+      ++matchLength;
+    }
+    if (!putSequence(src + anchor, pos - anchor, pos - match, matchLength,
+                     MIN_MATCH, dst, out, capacity)) {
+      return 0;
+    }
+    pos += matchLength;
+    anchor = pos;
+  }
+  if (!putSequence(src + anchor, length - anchor, 0, 0, MIN_MATCH, dst, out,
+                   capacity)) {
+    return 0;
+  }
+  return out;
+}
+
+bool PageCodec::decompress(const char *src, const std::size_t length,
+                           char *dst, const std::size_t expected) {
+  const unsigned char *in_bytes = reinterpret_cast<const unsigned char *>(src);
+  std::size_t in = 0;
+  std::size_t out = 0;
+  while (in < length) {
+    const unsigned char token = in_bytes[in++];
+    std::size_t literalLength = token >> 4;
+    if (literalLength == 15 && !getLength(in_bytes, in, length, literalLength)) {
+      return false;
+    }
+    if (in + literalLength > length || out + literalLength > expected) {
+      return false;
+    }
+    std::memcpy(dst + out, src + in, literalLength);
+    in += literalLength;
+    out += literalLength;
+    if (in == length) {
+      break;  // Final, literal-only sequence.
+    }
+
+    if (in + 2 > length) return false;
+    const std::size_t offset = in_bytes[in] | (in_bytes[in + 1] << 8);
+    in += 2;
+    std::size_t matchLength = token & 0x0f;
+    if (matchLength == 15 && !getLength(in_bytes, in, length, matchLength)) {
+      return false;
+    }
+    matchLength += MIN_MATCH;
+    if (offset == 0 || offset > out || out + matchLength > expected) {
+      return false;
+    }
+    // Byte by byte: the match may overlap the bytes it produces.
+    for (std::size_t i = 0; i < matchLength; ++i, ++out) {
+      dst[out] = dst[out - offset];
+    }
+  }
+  return out == expected;
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,70 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace badgerdb {
+
+/**
+ * @brief Fast byte-oriented LZ77 compressor for page images.
+ *
+ * The format is a sequence of (literals, match) pairs in the style of LZ4: a
+ * token byte holding the literal length and match length in its two nibbles
+ * (with 255-byte continuation bytes for longer runs), the literal bytes, and
+ * a two-byte little-endian offset back to the match.  The final sequence
+ * carries literals only.  Matches are found with a single-probe hash table,
+ * which trades some ratio for speed; slot arrays, record data and the zeroed
+ * free space in the middle of a page all compress well.
+ */
+class PageCodec {
+ public:
+  /**
+   * Compresses a buffer.
+   *
+   * @param src       Bytes to compress.
+   * @param length    Number of bytes to compress.
+   * @param dst       Buffer to compress into.
+   * @param capacity  Size of dst.
+   * @return  Compressed size, or 0 if the result does not fit in capacity.
+   */
+  static std::size_t compress(const char *src, const std::size_t length,
+                              char *dst, const std::size_t capacity);
+
+  /**
+   * Decompresses a buffer produced by compress().
+   *
+   * @param src       Compressed bytes.
+   * @param length    Number of compressed bytes.
+   * @param dst       Buffer to decompress into.
+   * @param expected  Exact size of the decompressed data.
+   * @return  False if the input is malformed or does not decompress to
+   *          exactly expected bytes.
+   */
+  static bool decompress(const char *src, const std::size_t length, char *dst,
+                         const std::size_t expected);
+
+ private:
+  /**
+   * Shortest match worth encoding.
+   */
+  static const std::size_t MIN_MATCH = 4;
+
+  /**
+   * Farthest back a match may start.
+   */
+  static const std::size_t MAX_OFFSET = 65535;
+
+  /**
+   * Number of bits of the match-finder hash.
+   */
+  static const int HASH_BITS = 12;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,292 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "posix_storage.h"
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "exceptions/io_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Drops the first transferred bytes from an iovec array.  Returns the index
+ * of the first buffer with bytes left.
+ */
+std::size_t advance(std::vector<struct iovec> &iov, std::size_t first,
+                    std::size_t transferred) {
+  while (first < iov.size() && transferred >= iov[first].iov_len) {
+    transferred -= iov[first].iov_len;
+    ++first;
+  }
+  if (first < iov.size()) {
+    iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + transferred;
+    iov[first].iov_len -= transferred;
+  }
+  return first;
+}
+
+/**
+ * Copies a range of one file to the same range of another, in the kernel
+ * where possible.
+ */
+void copyRange(const int source, const int target, const std::string &name,
+               std::uint64_t offset, std::uint64_t length) {
+  loff_t in = offset;
+  loff_t out = offset;
+  while (length > 0) {
+    const ssize_t copied = ::copy_file_range(source, &in, target, &out,
+                                             length, 0 /* flags */);
+    if (copied < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EXDEV || errno == EINVAL || errno == ENOSYS ||
+          errno == EOPNOTSUPP) {
+        break;  // Copy through user space instead.
+      }
+      throw IoException(name, "copy", errno);
+    }
+    if (copied == 0) {
+      return;  // Past the end of the source.
+    }
+    length -= copied;
+  }
+  offset = in;
+  std::vector<char> buffer(
+      static_cast<std::size_t>(std::min<std::uint64_t>(length, 1 << 20)));
+  while (length > 0) {
+    const ssize_t got = ::pread(
+        source, buffer.data(),
+        static_cast<std::size_t>(
+            std::min<std::uint64_t>(length, buffer.size())),
+        offset);
+    if (got < 0) {
+      if (errno == EINTR) continue;
+      throw IoException(name, "copy", errno);
+    }
+    if (got == 0) {
+      return;
+    }
+    ssize_t done = 0;
+    while (done < got) {
+      const ssize_t put =
+          ::pwrite(target, buffer.data() + done, got - done, offset + done);
+      if (put < 0) {
+        if (errno == EINTR) continue;
+        throw IoException(name, "copy", errno);
+      }
+      done += put;
+    }
+    offset += got;
+    length -= got;
+  }
+}
+
+/**
+ * Copies a file on several threads, each taking one range of at least
+ * MIN_RANGE bytes.
+ */
+void copyParallel(const int source, const int target, const std::string &name,
+                  const std::uint64_t size) {
+  const std::uint64_t MIN_RANGE = 16 << 20;
+  const std::uint64_t num_threads = std::max<std::uint64_t>(
+      1, std::min<std::uint64_t>(std::thread::hardware_concurrency(),
+                                 size / MIN_RANGE));
+  const std::uint64_t range = (size + num_threads - 1) / num_threads;
+  std::vector<std::future<void>> others;
+  for (std::uint64_t t = 1; t < num_threads; ++t) {
+    const std::uint64_t offset = t * range;
+    const std::uint64_t length = std::min(range, size - offset);
+    others.push_back(std::async(
+        std::launch::async, [source, target, &name, offset, length]() {
+          copyRange(source, target, name, offset, length);
+        }));
+  }
+  std::exception_ptr error;
+  try {
+    copyRange(source, target, name, 0, std::min(range, size));
+  } catch (...) {
+    error = std::current_exception();
+  }
+  for (std::future<void> &other : others) {
+    try {
+      other.get();
+    } catch (...) {
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+}  // namespace
+
+PosixStorage::PosixStorage(const std::string &name, const bool create,
+                            const bool temporary)
+    : name_(name) {
+  fd_ = ::open(name.c_str(),
+               O_RDWR | O_CREAT | (create || temporary ? O_TRUNC : 0), 0644);
+  if (fd_ < 0) {
+    throw IoException(name_, "open", errno);
+  }
+  if (temporary) {
+    // The descriptor keeps the file alive; the kernel reclaims it on close.
+    ::unlink(name.c_str());
+  }
+}
+
+PosixStorage::~PosixStorage() { ::close(fd_); }
+
+void PosixStorage::read(const std::uint64_t offset, char *data,
+                        const std::size_t length) {
+  IoBuffer buffer = {data, length};
+  readv(offset, &buffer, 1);
+}
+
+void PosixStorage::write(const std::uint64_t offset, const char *data,
+                         const std::size_t length) {
+  ConstIoBuffer buffer = {data, length};
+  writev(offset, &buffer, 1);
+}
+
+void PosixStorage::readv(const std::uint64_t offset, const IoBuffer *buffers,
+                         const std::size_t count) {
+  std::vector<struct iovec> iov(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    iov[i].iov_base = buffers[i].data;
+    iov[i].iov_len = buffers[i].length;
+  }
+  std::uint64_t position = offset;
+  std::size_t first = 0;
+  while (first < iov.size()) {
+    const std::size_t batch =
+        std::min<std::size_t>(iov.size() - first, IOV_MAX);
+    const ssize_t transferred = ::preadv(fd_, &iov[first], batch, position);
+    if (transferred < 0) {
+      if (errno == EINTR) continue;
+      throw IoException(name_, "read", errno);
+    }
+    if (transferred == 0) {
+      // Past the end of the file.
+      for (; first < iov.size(); ++first) {
+        std::memset(iov[first].iov_base, 0, iov[first].iov_len);
+      }
+      break;
+    }
+    position += transferred;
+    first = advance(iov, first, transferred);
+  }
+}
+
+void PosixStorage::writev(const std::uint64_t offset,
+                          const ConstIoBuffer *buffers,
+                          const std::size_t count) {
+  std::vector<struct iovec> iov(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    iov[i].iov_base = const_cast<char *>(buffers[i].data);
+    iov[i].iov_len = buffers[i].length;
+  }
+  std::uint64_t position = offset;
+  std::size_t first = 0;
+  while (first < iov.size()) {
+    const std::size_t batch =
+        std::min<std::size_t>(iov.size() - first, IOV_MAX);
+    const ssize_t transferred = ::pwritev(fd_, &iov[first], batch, position);
+    if (transferred < 0) {
+      if (errno == EINTR) continue;
+      throw IoException(name_, "write", errno);
+    }
+    position += transferred;
+    first = advance(iov, first, transferred);
+  }
+}
+
+void PosixStorage::sync() {
+  if (::fdatasync(fd_) != 0) {
+    throw IoException(name_, "sync", errno);
+  }
+}
+
+std::uint64_t PosixStorage::size() {
+  struct stat status;
+  if (::fstat(fd_, &status) != 0) {
+    throw IoException(name_, "stat", errno);
+  }
+  return status.st_size;
+}
+
+void PosixStorage::punchHole(const std::uint64_t offset,
+                             const std::uint64_t length) {
+  if (::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset,
+                  length) == 0) {
+    return;
+  }
+  if (errno != EOPNOTSUPP) {
+    throw IoException(name_, "punch hole", errno);
+  }
+  // The filesystem cannot release the space; just zero the range.
+  StorageBackend::punchHole(offset, length);
+}
+
+void PosixStorage::snapshot(const std::string &name) {
+  copyFile(fd_, size(), name);
+}
+
+void PosixStorage::copyFile(const int source, const std::uint64_t size,
+                            const std::string &name) {
+  const int target =
+      ::open(name.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (target < 0) {
+    throw IoException(name, "open", errno);
+  }
+  try {
+    if (::ioctl(target, FICLONE, source) != 0) {
+      if (errno != EOPNOTSUPP && errno != EXDEV && errno != EINVAL &&
+          errno != ENOTTY) {
+        throw IoException(name, "clone", errno);
+      }
+      // No copy-on-write clones here; copy the data.  Sizing the copy
+      // first lets the threads write their ranges independently.
+      if (::ftruncate(target, size) != 0) {
+        throw IoException(name, "extend", errno);
+      }
+      copyParallel(source, target, name, size);
+    }
+  } catch (...) {
+    ::close(target);
+    ::unlink(name.c_str());
+    throw;
+  }
+  ::close(target);
+}
+
+void PosixStorage::truncate(const std::uint64_t size) {
+  if (size < this->size() && ::ftruncate(fd_, size) != 0) {
+    throw IoException(name_, "truncate", errno);
+  }
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,82 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "storage_backend.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Storage in a filesystem file, accessed with pread/pwrite and their
+ * vectored variants.
+ */
+class PosixStorage : public StorageBackend {
+ public:
+  /**
+   * Opens the file, creating it if it does not exist.
+   *
+   * @param name    Name of the file.
+   * @param create  Whether to truncate the file.
+   * @param temporary Whether to unlink the file once it is open.
+   * @throws  IoException  If the file cannot be opened.
+   */
+  PosixStorage(const std::string &name, const bool create,
+               const bool temporary = false);
+
+  PosixStorage(const PosixStorage &) = delete;
+  PosixStorage &operator=(const PosixStorage &) = delete;
+
+  /**
+   * Closes the file.
+   */
+  ~PosixStorage();
+
+  void read(const std::uint64_t offset, char *data,
+            const std::size_t length) override;
+  void write(const std::uint64_t offset, const char *data,
+             const std::size_t length) override;
+  void readv(const std::uint64_t offset, const IoBuffer *buffers,
+             const std::size_t count) override;
+  void writev(const std::uint64_t offset, const ConstIoBuffer *buffers,
+              const std::size_t count) override;
+  void sync() override;
+  std::uint64_t size() override;
+  void punchHole(const std::uint64_t offset,
+                 const std::uint64_t length) override;
+  void truncate(const std::uint64_t size) override;
+  void snapshot(const std::string &name) override;
+
+  /**
+   * Copies an open filesystem file to a new file, cloning it copy-on-write
+   * if the filesystem supports it and copying it on several threads if not.
+   *
+   * @param source      Descriptor of the file to copy.
+   * @param size        Size of the file in bytes.
+   * @param name        Name of the copy.
+   * @throws  IoException  If the copy cannot be made; no copy is left.
+   */
+  static void copyFile(const int source, const std::uint64_t size,
+                       const std::string &name);
+
+ private:
+  /**
+   * Name of the file, for error messages.
+   */
+  std::string name_;
+
+  /**
+   * File descriptor.
+   */
+  int fd_;
+};
+
+}  // namespace badgerdb
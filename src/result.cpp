@@ -0,0 +1,80 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "result.h"
+
+#include "exceptions/insufficient_space_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/invalid_record_exception.h"
+
+namespace badgerdb {
+
+Error Error::invalidPage(const PageId page_number,
+                         const std::shared_ptr<const std::string> &filename) {
+  Error error;
+  error.code_ = ErrorCode::INVALID_PAGE;
+  error.page_number_ = page_number;
+  error.filename_ = filename;
+  return error;
+}
+
+Error Error::insufficientSpace(const PageId page_number,
+                               const std::size_t requested,
+                               const std::size_t available) {
+  Error error;
+  error.code_ = ErrorCode::INSUFFICIENT_SPACE;
+  error.page_number_ = page_number;
+  error.requested_ = static_cast<std::uint32_t>(requested);
+  error.available_ = static_cast<std::uint32_t>(available);
+  return error;
+}
+
+Error Error::invalidRecord(const RecordId &record_id,
+                           const PageId page_number) {
+  Error error;
+  error.code_ = ErrorCode::INVALID_RECORD;
+  error.page_number_ = page_number;
+  error.record_page_number_ = record_id.page_number;
+  error.slot_number_ = record_id.slot_number;
+  return error;
+}
+
+std::string Error::message() const {
+  switch (code_) {
+    case ErrorCode::OK:
+      return "";
+    case ErrorCode::INVALID_PAGE:
+      return InvalidPageException(page_number_, *filename_).message();
+    case ErrorCode::INSUFFICIENT_SPACE:
+      return InsufficientSpaceException(page_number_, requested_, available_)
+          .message();
+    case ErrorCode::INVALID_RECORD:
+      return InvalidRecordException({record_page_number_, slot_number_},
+                                    page_number_)
+          .message();
+  }
+  return "";
+}
+
+void Error::raise() const {
+  switch (code_) {
+    case ErrorCode::INVALID_PAGE:
+      throw InvalidPageException(page_number_, *filename_);
+    case ErrorCode::INSUFFICIENT_SPACE:
+      throw InsufficientSpaceException(page_number_, requested_, available_);
+    case ErrorCode::INVALID_RECORD:
+      throw InvalidRecordException({record_page_number_, slot_number_},
+                                   page_number_);
+    case ErrorCode::OK:
+      break;
+  }
+  assert(false);
+  throw;
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,210 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Reason an operation failed.
+ */
+enum class ErrorCode : std::uint8_t {
+  /**
+   * The operation succeeded.
+   */
+  OK,
+
+  /**
+   * The page does not exist in the file or is not currently used.
+   */
+  INVALID_PAGE,
+
+  /**
+   * The page does not have enough free space to hold the record.
+   */
+  INSUFFICIENT_SPACE,
+
+  /**
+   * The record does not exist on the page.
+   */
+  INVALID_RECORD,
+};
+
+/**
+ * @brief Failure of an operation that does not throw.
+ *
+ * Holds only an error code, the numbers describing the failure and a shared
+ * reference to the file name, so reporting an error costs no allocation and
+ * the error stays valid after the object that reported it is gone.  The
+ * message is formatted when message() is called, and is the same as that of
+ * the exception the throwing variant of the operation would have thrown.
+ */
+class Error {
+ public:
+  /**
+   * Constructs an error meaning success.
+   */
+  Error()
+      : code_(ErrorCode::OK),
+        slot_number_(0),
+        page_number_(0),
+        record_page_number_(0),
+        requested_(0),
+        available_(0) {}
+
+  /**
+   * Returns an error for a page that does not exist or is not used.
+   *
+   * @param page_number Number of the page requested.
+   * @param filename    Name of the file.
+   */
+  static Error invalidPage(const PageId page_number,
+                           const std::shared_ptr<const std::string> &filename);
+
+  /**
+   * Returns an error for a record that does not fit on a page.
+   *
+   * @param page_number Number of the page.
+   * @param requested   Bytes needed for the record.
+   * @param available   Bytes free on the page.
+   */
+  static Error insufficientSpace(const PageId page_number,
+                                 const std::size_t requested,
+                                 const std::size_t available);
+
+  /**
+   * Returns an error for a record that is not on a page.
+   *
+   * @param record_id   ID of the record requested.
+   * @param page_number Number of the page searched.
+   */
+  static Error invalidRecord(const RecordId &record_id,
+                             const PageId page_number);
+
+  /**
+   * Returns the reason the operation failed.
+   */
+  ErrorCode code() const { return code_; }
+
+  /**
+   * Formats a message describing the error.
+   */
+  std::string message() const;
+
+  /**
+   * Throws the exception the throwing variant of the operation would have
+   * thrown.  Must not be called on an error meaning success.
+   */
+  [[noreturn]] void raise() const;
+
+ private:
+  ErrorCode code_;
+  SlotId slot_number_;
+  PageId page_number_;
+  PageId record_page_number_;
+  std::uint32_t requested_;
+  std::uint32_t available_;
+  std::shared_ptr<const std::string> filename_;
+};
+
+/**
+ * @brief Either the value an operation produced or the reason it failed.
+ *
+ * A minimal stand-in for std::expected, which is not available in C++14.
+ * No value is constructed when the operation fails.
+ */
+template <typename T>
+class Result {
+ public:
+  /**
+   * Constructs a successful result.
+   *
+   * @param value Value the operation produced.
+   */
+  Result(T value) : has_value_(true) { new (&value_) T(std::move(value)); }
+
+  /**
+   * Constructs a failed result.
+   *
+   * @param error Reason the operation failed.
+   */
+  Result(const Error &error) : has_value_(false), error_(error) {}
+
+  Result(Result &&other) : has_value_(other.has_value_) {
+    if (has_value_) {
+      new (&value_) T(std::move(other.value_));
+    } else {
+      new (&error_) Error(other.error_);
+    }
+  }
+
+  Result(const Result &) = delete;
+  Result &operator=(const Result &) = delete;
+
+  ~Result() {
+    if (has_value_) {
+      value_.~T();
+    } else {
+      error_.~Error();
+    }
+  }
+
+  /**
+   * Returns whether the operation succeeded.
+   */
+  bool ok() const { return has_value_; }
+
+  explicit operator bool() const { return has_value_; }
+
+  /**
+   * Returns the value.  Must only be called if ok().
+   */
+  T &value() {
+    assert(has_value_);
+    return value_;
+  }
+
+  const T &value() const {
+    assert(has_value_);
+    return value_;
+  }
+
+  /**
+   * Returns the value, throwing the operation's exception if it failed.
+   */
+  T &valueOrThrow() {
+    if (!has_value_) {
+      error_.raise();
+    }
+    return value_;
+  }
+
+  /**
+   * Returns the reason the operation failed, or an error meaning success.
+   */
+  Error error() const { return has_value_ ? Error() : error_; }
+
+ private:
+  bool has_value_;
+  union {
+    T value_;
+    Error error_;
+  };
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,105 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "secondary_cache.h"
+
+#include "exceptions/io_exception.h"
+
+namespace badgerdb {
+
+SecondaryCache::SecondaryCache(const std::string &path,
+                               const std::uint32_t capacity,
+                               const std::uint32_t admitAfterHits,
+                               const StorageOptions &options)
+    : capacity_(capacity), admit_after_hits_(admitAfterHits), head_(0) {
+  StorageOptions cache_options = options;
+  cache_options.temporary = true;
+  storage_ = StorageBackend::open(path, cache_options, true /* create */);
+  slots_.assign(capacity_, index_.end());
+}
+
+void SecondaryCache::insert(const std::string &filename, const Page &page) {
+  if (capacity_ == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Key key(filename, page.page_number());
+  Index::iterator existing = index_.find(key);
+  if (existing != index_.end()) {
+    drop(existing);
+  }
+  // The head overwrites the oldest slot in the log.
+  if (slots_[head_] != index_.end()) {
+    drop(slots_[head_]);
+  }
+
+  const ConstIoBuffer buffers[] = {
+      {reinterpret_cast<const char *>(&page.header_), sizeof(page.header_)},
+      {page.data_.data(), Page::DATA_SIZE}};
+  try {
+    storage_->writev(static_cast<std::uint64_t>(head_) * Page::SIZE, buffers,
+                     2);
+  } catch (const IoException &) {
+    // Out of space on the cache device; the page is simply not cached.
+    return;
+  }
+
+  slots_[head_] = index_.insert(std::make_pair(key, head_)).first;
+  head_ = (head_ + 1) % capacity_;
+}
+
+bool SecondaryCache::take(const std::string &filename,
+                          const PageId page_number, Page &page) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Index::iterator entry = index_.find(Key(filename, page_number));
+  if (entry == index_.end()) {
+    return false;
+  }
+  const IoBuffer buffers[] = {
+      {reinterpret_cast<char *>(&page.header_), sizeof(page.header_)},
+      {&page.data_[0], Page::DATA_SIZE}};
+  bool ok = true;
+  try {
+    storage_->readv(static_cast<std::uint64_t>(entry->second) * Page::SIZE,
+                    buffers, 2);
+  } catch (const IoException &) {
+    ok = false;
+  }
+  page.dirty_sectors_ = 0;
+  drop(entry);
+  return ok && page.page_number() == page_number;
+}
+
+void SecondaryCache::erase(const std::string &filename,
+                           const PageId page_number) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Index::iterator entry = index_.find(Key(filename, page_number));
+  if (entry != index_.end()) {
+    drop(entry);
+  }
+}
+
+void SecondaryCache::eraseFile(const std::string &filename) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Index::iterator entry = index_.lower_bound(Key(filename, 0));
+  while (entry != index_.end() && entry->first.first == filename) {
+    drop(entry++);
+  }
+}
+
+std::uint32_t SecondaryCache::size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return index_.size();
+}
+
+void SecondaryCache::drop(Index::iterator entry) {
+  slots_[entry->second] = index_.end();
+  index_.erase(entry);
+}
+
+}  // namespace badgerdb
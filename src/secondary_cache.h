@@ -0,0 +1,163 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "page.h"
+#include "storage_backend.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Second-level page cache kept in a file on fast local storage.
+ *
+ * Holds clean pages evicted from the buffer pool so that a later miss can be
+ * served from local flash instead of the (slow) device holding the database
+ * file.  The cache file is a circular log of page-sized slots: every admitted
+ * page is appended at the log head, and the entry whose slot the head
+ * overwrites is dropped.  Only the in-memory index knows what a slot holds,
+ * so the cache starts empty every time it is opened.  The file is accessed
+ * through a temporary StorageBackend of any kind, so it disappears once the
+ * cache is destroyed.
+ *
+ * The cache is exclusive with the buffer pool: a page is removed from the
+ * cache when it is read back into a frame, so it can never hold a stale copy
+ * of a page that has since been modified in the pool.
+ *
+ * Pages are identified by file name, so cached pages of a file must be
+ * dropped with eraseFile() before a file of the same name is recreated.
+ */
+class SecondaryCache {
+ public:
+  /**
+   * Creates (or truncates) the cache file.
+   *
+   * @param path            Name of the cache file.
+   * @param capacity        Number of pages the cache holds.
+   * @param admitAfterHits  Number of buffer pool hits an evicted page must
+   *                        have had to be admitted; 0 admits every page.
+   * @param options         Storage to keep the cache file on; it is always
+   *                        opened as temporary storage.
+   * @throws  IoException  If the cache file cannot be created.
+   */
+  SecondaryCache(const std::string &path, const std::uint32_t capacity,
+                 const std::uint32_t admitAfterHits,
+                 const StorageOptions &options = StorageOptions());
+
+  SecondaryCache(const SecondaryCache &) = delete;
+  SecondaryCache &operator=(const SecondaryCache &) = delete;
+
+  /**
+   * Returns true if an evicted page with the given number of hits should be
+   * admitted.  Pages that were touched only once are likely one-off reads and
+   * would only push useful pages out of the log.
+   *
+   * @param hits  Number of buffer pool hits the page had while resident.
+   */
+  bool shouldAdmit(const std::uint32_t hits) const {
+    return hits >= admit_after_hits_;
+  }
+
+  /**
+   * Appends a page at the log head, replacing any cached copy of it.
+   *
+   * @param filename  Name of the file the page belongs to.
+   * @param page      Page to cache.
+   */
+  void insert(const std::string &filename, const Page &page);
+
+  /**
+   * Removes a page from the cache and returns its contents.
+   *
+   * @param filename    Name of the file the page belongs to.
+   * @param page_number Number of the page.
+   * @param page        Page to read into.
+   * @return  True if the page was cached.
+   */
+  bool take(const std::string &filename, const PageId page_number,
+            Page &page);
+
+  /**
+   * Drops the cached copy of a page, if any.
+   *
+   * @param filename    Name of the file the page belongs to.
+   * @param page_number Number of the page.
+   */
+  void erase(const std::string &filename, const PageId page_number);
+
+  /**
+   * Drops every cached page of a file.
+   *
+   * @param filename  Name of the file.
+   */
+  void eraseFile(const std::string &filename);
+
+  /**
+   * Returns the number of pages currently cached.
+   */
+  std::uint32_t size();
+
+ private:
+  typedef std::pair<std::string, PageId> Key;
+  typedef std::map<Key, std::uint32_t> Index;
+
+  /**
+   * Removes an index entry and marks its slot empty.  Caller must hold
+   * mutex_.
+   *
+   * @param entry   Index entry to remove.
+   */
+  void drop(Index::iterator entry);
+
+  /**
+   * Number of slots in the log.
+   */
+  std::uint32_t capacity_;
+
+  /**
+   * Minimum number of hits for admission.
+   */
+  std::uint32_t admit_after_hits_;
+
+  /**
+   * Maps (file name, page number) to the slot holding the page.
+   */
+  Index index_;
+
+  /**
+   * Index entry of the page in each slot, or index_.end() if the slot holds
+   * nothing useful.
+   */
+  std::vector<Index::iterator> slots_;
+
+  /**
+   * Next slot to write.
+   */
+  std::uint32_t head_;
+
+  /**
+   * Storage of the cache file.
+   */
+  std::shared_ptr<StorageBackend> storage_;
+
+  /**
+   * Guards every member above.
+   */
+  std::mutex mutex_;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,218 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "segmented_storage.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace badgerdb {
+
+SegmentedStorage::SegmentedStorage(const std::string &name,
+                                   const StorageOptions &options,
+                                   const bool create)
+    : name_(name),
+      options_(options),
+      segment_size_(options.segmentSize),
+      num_segments_(1) {
+  // Latency is simulated once around the whole file.
+  options_.segmentSize = 0;
+  options_.readLatency = std::chrono::microseconds(0);
+  options_.writeLatency = std::chrono::microseconds(0);
+  if (create) {
+    for (std::uint64_t n = 1; StorageBackend::exists(segmentName(name_, n));
+         ++n) {
+      StorageBackend::remove(segmentName(name_, n));
+    }
+  }
+  segments_.push_back(StorageBackend::open(name_, options_, create));
+  if (!options_.temporary) {
+    while (StorageBackend::exists(segmentName(name_, num_segments_))) {
+      ++num_segments_;
+    }
+  }
+}
+
+std::string SegmentedStorage::segmentName(const std::string &name,
+                                          const std::uint64_t segment) {
+  return segment == 0 ? name : name + "." + std::to_string(segment);
+}
+
+void SegmentedStorage::read(const std::uint64_t offset, char *data,
+                            const std::size_t length) {
+  std::uint64_t position = offset;
+  std::size_t done = 0;
+  while (done < length) {
+    const std::uint64_t within = position % segment_size_;
+    const std::size_t chunk = static_cast<std::size_t>(
+        std::min<std::uint64_t>(length - done, segment_size_ - within));
+    std::shared_ptr<StorageBackend> storage =
+        segment(position / segment_size_, false /* create */);
+    if (storage) {
+      storage->read(within, data + done, chunk);
+    } else {
+      std::memset(data + done, 0, chunk);
+    }
+    position += chunk;
+    done += chunk;
+  }
+}
+
+void SegmentedStorage::write(const std::uint64_t offset, const char *data,
+                             const std::size_t length) {
+  std::uint64_t position = offset;
+  std::size_t done = 0;
+  while (done < length) {
+    const std::uint64_t within = position % segment_size_;
+    const std::size_t chunk = static_cast<std::size_t>(
+        std::min<std::uint64_t>(length - done, segment_size_ - within));
+    segment(position / segment_size_, true /* create */)
+        ->write(within, data + done, chunk);
+    position += chunk;
+    done += chunk;
+  }
+}
+
+void SegmentedStorage::readv(const std::uint64_t offset,
+                             const IoBuffer *buffers, const std::size_t count) {
+  const std::uint64_t length = totalLength(buffers, count);
+  const std::uint64_t first = offset / segment_size_;
+  if (length > 0 && (offset + length - 1) / segment_size_ == first) {
+    std::shared_ptr<StorageBackend> storage =
+        segment(first, false /* create */);
+    if (storage) {
+      storage->readv(offset % segment_size_, buffers, count);
+      return;
+    }
+  }
+  StorageBackend::readv(offset, buffers, count);
+}
+
+void SegmentedStorage::writev(const std::uint64_t offset,
+                              const ConstIoBuffer *buffers,
+                              const std::size_t count) {
+  const std::uint64_t length = totalLength(buffers, count);
+  const std::uint64_t first = offset / segment_size_;
+  if (length > 0 && (offset + length - 1) / segment_size_ == first) {
+    segment(first, true /* create */)
+        ->writev(offset % segment_size_, buffers, count);
+    return;
+  }
+  StorageBackend::writev(offset, buffers, count);
+}
+
+void SegmentedStorage::sync() {
+  std::vector<std::shared_ptr<StorageBackend>> opened;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    opened = segments_;
+  }
+  for (const std::shared_ptr<StorageBackend> &storage : opened) {
+    if (storage) {
+      storage->sync();
+    }
+  }
+}
+
+std::uint64_t SegmentedStorage::size() {
+  std::uint64_t last;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    last = num_segments_ - 1;
+  }
+  return last * segment_size_ + segment(last, false /* create */)->size();
+}
+
+void SegmentedStorage::punchHole(const std::uint64_t offset,
+                                 const std::uint64_t length) {
+  std::uint64_t position = offset;
+  const std::uint64_t end = offset + length;
+  while (position < end) {
+    const std::uint64_t within = position % segment_size_;
+    const std::uint64_t chunk =
+        std::min<std::uint64_t>(end - position, segment_size_ - within);
+    std::shared_ptr<StorageBackend> storage =
+        segment(position / segment_size_, false /* create */);
+    if (!storage) {
+      break;  // No segments past this one.
+    }
+    storage->punchHole(within, chunk);
+    position += chunk;
+  }
+}
+
+void SegmentedStorage::truncate(const std::uint64_t size) {
+  // The first segment is kept even when empty; it marks the file's presence.
+  const std::uint64_t keep = std::max<std::uint64_t>(
+      1, (size + segment_size_ - 1) / segment_size_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (keep > num_segments_) {
+      return;
+    }
+    for (std::uint64_t n = keep; n < num_segments_; ++n) {
+      if (n < segments_.size()) {
+        segments_[n].reset();
+      }
+      StorageBackend::remove(segmentName(name_, n));
+    }
+    if (segments_.size() > keep) {
+      segments_.resize(keep);
+    }
+    num_segments_ = keep;
+  }
+  segment(keep - 1, false /* create */)
+      ->truncate(size - (keep - 1) * segment_size_);
+}
+
+void SegmentedStorage::snapshot(const std::string &name) {
+  std::uint64_t num_segments;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    num_segments = num_segments_;
+  }
+  for (std::uint64_t n = 0; n < num_segments; ++n) {
+    segment(n, false /* create */)->snapshot(segmentName(name, n));
+  }
+}
+
+std::shared_ptr<StorageBackend> SegmentedStorage::segment(
+    const std::uint64_t segment, const bool create) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (segment < segments_.size() && segments_[segment]) {
+    return segments_[segment];
+  }
+  if (segment >= num_segments_ && !create) {
+    return std::shared_ptr<StorageBackend>();
+  }
+  if (segments_.size() <= segment) {
+    segments_.resize(segment + 1);
+  }
+  // Create any missing segments before this one too, so that reopening the
+  // file finds them all.
+  for (std::uint64_t n = num_segments_; n < segment; ++n) {
+    segments_[n] = StorageBackend::open(segmentName(name_, n), options_,
+                                        true /* create */);
+  }
+  segments_[segment] = StorageBackend::open(segmentName(name_, segment),
+                                            options_, segment >= num_segments_);
+  num_segments_ = std::max(num_segments_, segment + 1);
+  return segments_[segment];
+}
+
+template <typename Buffer>
+std::uint64_t SegmentedStorage::totalLength(const Buffer *buffers,
+                                            const std::size_t count) {
+  std::uint64_t length = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    length += buffers[i].length;
+  }
+  return length;
+}
+
+}  // namespace badgerdb
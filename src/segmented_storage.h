@@ -0,0 +1,120 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "storage_backend.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Storage split into fixed-size segments, each kept in its own file.
+ *
+ * Segment 0 is stored under the file's own name and segment n under the name
+ * followed by ".n", so a file's presence is still that of its first segment.
+ * Segments are opened the first time they are accessed.  Reads of segments
+ * that do not exist yet return zeros; a write creates its segment along with
+ * any missing segments before it, so the segments on disk never have gaps.
+ *
+ * Each segment is an independent storage of the configured kind, so
+ * requests to different segments go to different files and can proceed in
+ * parallel.
+ */
+class SegmentedStorage : public StorageBackend {
+ public:
+  /**
+   * Opens the first segment; the others are opened lazily.
+   *
+   * @param name    Name of the file.
+   * @param options Kind of storage of each segment and the segment size.
+   * @param create  Whether to discard any existing segments.
+   * @throws  IoException  If the first segment cannot be opened.
+   */
+  SegmentedStorage(const std::string &name, const StorageOptions &options,
+                   const bool create);
+
+  /**
+   * Returns the name of a segment of a file.
+   *
+   * @param name    Name of the file.
+   * @param segment Number of the segment.
+   */
+  static std::string segmentName(const std::string &name,
+                                 const std::uint64_t segment);
+
+  void read(const std::uint64_t offset, char *data,
+            const std::size_t length) override;
+  void write(const std::uint64_t offset, const char *data,
+             const std::size_t length) override;
+  void readv(const std::uint64_t offset, const IoBuffer *buffers,
+             const std::size_t count) override;
+  void writev(const std::uint64_t offset, const ConstIoBuffer *buffers,
+              const std::size_t count) override;
+  void sync() override;
+  std::uint64_t size() override;
+  void punchHole(const std::uint64_t offset,
+                 const std::uint64_t length) override;
+  void truncate(const std::uint64_t size) override;
+  void snapshot(const std::string &name) override;
+
+ private:
+  /**
+   * Returns a segment, opening it if necessary.
+   *
+   * @param segment Number of the segment.
+   * @param create  Whether to create the segment if it does not exist.
+   * @return  The segment, or null if it does not exist and create is false.
+   */
+  std::shared_ptr<StorageBackend> segment(const std::uint64_t segment,
+                                          const bool create);
+
+  /**
+   * Returns the total length of a list of buffers.
+   */
+  template <typename Buffer>
+  static std::uint64_t totalLength(const Buffer *buffers,
+                                   const std::size_t count);
+
+  /**
+   * Name of the file.
+   */
+  std::string name_;
+
+  /**
+   * Options each segment is opened with.
+   */
+  StorageOptions options_;
+
+  /**
+   * Size of a segment in bytes.
+   */
+  std::uint64_t segment_size_;
+
+  /**
+   * Segments opened so far, by number; null where not opened yet.
+   */
+  std::vector<std::shared_ptr<StorageBackend>> segments_;
+
+  /**
+   * Number of segments that exist.
+   */
+  std::uint64_t num_segments_;
+
+  /**
+   * Guards segments_ and num_segments_.
+   */
+  std::mutex mutex_;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,493 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "shared_buffer_pool.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/io_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Identifies an initialized segment.
+ */
+const std::uint32_t MAGIC = 0x42445350;
+
+/**
+ * Alignment of the sections of a segment.
+ */
+const std::size_t ALIGNMENT = 4096;
+
+std::size_t align(const std::size_t offset) {
+  return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+/**
+ * Shared memory object names start with a slash.
+ */
+std::string objectName(const std::string &name) {
+  return !name.empty() && name[0] == '/' ? name : "/" + name;
+}
+
+/**
+ * Holds a robust process-shared mutex, making it consistent again if the
+ * process holding it died.
+ */
+class SegmentLock {
+ public:
+  explicit SegmentLock(pthread_mutex_t *mutex) : mutex_(mutex) {
+    if (pthread_mutex_lock(mutex_) == EOWNERDEAD) {
+      pthread_mutex_consistent(mutex_);
+    }
+  }
+
+  ~SegmentLock() { pthread_mutex_unlock(mutex_); }
+
+  SegmentLock(const SegmentLock &) = delete;
+  SegmentLock &operator=(const SegmentLock &) = delete;
+
+ private:
+  pthread_mutex_t *mutex_;
+};
+
+}  // namespace
+
+const std::size_t SharedBufferPool::MAX_NAME;
+const std::int32_t SharedBufferPool::EMPTY_SLOT;
+
+std::shared_ptr<SharedBufferPool> SharedBufferPool::create(
+    const std::string &name, const std::uint32_t numFrames) {
+  std::uint32_t table_size = 1;
+  while (table_size < 2 * numFrames) {
+    table_size *= 2;
+  }
+  const std::size_t size = segmentSize(numFrames, table_size);
+  const std::string object = objectName(name);
+  const int fd = ::shm_open(object.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    throw IoException(object, "create", errno);
+  }
+  if (::ftruncate(fd, size) != 0) {
+    const int error = errno;
+    ::close(fd);
+    ::shm_unlink(object.c_str());
+    throw IoException(object, "truncate", error);
+  }
+  std::shared_ptr<SharedBufferPool> pool(
+      new SharedBufferPool(object, fd, size));
+
+  Header *header = pool->header_;
+  header->magic = MAGIC;
+  header->num_frames = numFrames;
+  header->table_size = table_size;
+  header->clock_hand = 0;
+  header->segment_size = size;
+  pthread_mutexattr_t mutex_attr;
+  pthread_mutexattr_init(&mutex_attr);
+  pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+  pthread_mutex_init(&header->mutex, &mutex_attr);
+  pthread_mutexattr_destroy(&mutex_attr);
+
+  pool->locate();
+  pthread_rwlockattr_t latch_attr;
+  pthread_rwlockattr_init(&latch_attr);
+  pthread_rwlockattr_setpshared(&latch_attr, PTHREAD_PROCESS_SHARED);
+  for (std::uint32_t i = 0; i < numFrames; ++i) {
+    pthread_rwlock_init(&pool->frames_[i].latch, &latch_attr);
+  }
+  pthread_rwlockattr_destroy(&latch_attr);
+  for (std::uint32_t i = 0; i < table_size; ++i) {
+    pool->table_[i] = EMPTY_SLOT;
+  }
+  header->ready.store(1, std::memory_order_release);
+  return pool;
+}
+
+std::shared_ptr<SharedBufferPool> SharedBufferPool::attach(
+    const std::string &name) {
+  const std::string object = objectName(name);
+  const int fd = ::shm_open(object.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    throw IoException(object, "attach", errno);
+  }
+  // The creator sizes the object right after creating it.
+  struct stat status;
+  do {
+    if (::fstat(fd, &status) != 0) {
+      const int error = errno;
+      ::close(fd);
+      throw IoException(object, "attach", error);
+    }
+    if (status.st_size == 0) {
+      std::this_thread::yield();
+    }
+  } while (status.st_size == 0);
+  std::shared_ptr<SharedBufferPool> pool(
+      new SharedBufferPool(object, fd, status.st_size));
+  while (pool->header_->ready.load(std::memory_order_acquire) == 0) {
+    std::this_thread::yield();
+  }
+  if (pool->header_->magic != MAGIC ||
+      pool->header_->segment_size !=
+          static_cast<std::uint64_t>(status.st_size)) {
+    throw IoException(object, "attach", EINVAL);
+  }
+  pool->locate();
+  return pool;
+}
+
+void SharedBufferPool::remove(const std::string &name) {
+  ::shm_unlink(objectName(name).c_str());
+}
+
+SharedBufferPool::SharedBufferPool(const std::string &name, const int fd,
+                                   const std::size_t size)
+    : name_(name), size_(size) {
+  segment_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  const int error = errno;
+  ::close(fd);
+  if (segment_ == MAP_FAILED) {
+    throw IoException(name_, "mmap", error);
+  }
+  header_ = static_cast<Header *>(segment_);
+}
+
+SharedBufferPool::~SharedBufferPool() { ::munmap(segment_, size_); }
+
+std::uint32_t SharedBufferPool::numFrames() const {
+  return header_->num_frames;
+}
+
+void SharedBufferPool::readPage(File &file, const PageId page_number,
+                                Page &page) {
+  const std::uint32_t frame_number =
+      pin(file, page_number, false /* exclusive */, false /* installing */);
+  copyOut(images_ + std::size_t(frame_number) * Page::SIZE, page);
+  unpin(frame_number, 0);
+}
+
+void SharedBufferPool::writePage(File &file, const Page &page) {
+  const std::uint32_t frame_number = pin(
+      file, page.page_number(), true /* exclusive */, true /* installing */);
+  copyIn(page, images_ + std::size_t(frame_number) * Page::SIZE);
+  unpin(frame_number, page.dirty_sectors());
+}
+
+void SharedBufferPool::updatePage(File &file, const PageId page_number,
+                                  const std::function<void(Page &)> &update) {
+  const std::uint32_t frame_number =
+      pin(file, page_number, true /* exclusive */, false /* installing */);
+  char *image = images_ + std::size_t(frame_number) * Page::SIZE;
+  Page page;
+  std::uint32_t dirty_sectors = 0;
+  try {
+    copyOut(image, page);
+    update(page);
+    copyIn(page, image);
+    dirty_sectors = page.dirty_sectors();
+  } catch (...) {
+    unpin(frame_number, 0);
+    throw;
+  }
+  unpin(frame_number, dirty_sectors);
+}
+
+void SharedBufferPool::flushFile(File &file) {
+  // Claim the dirty frames under the pool mutex, then write them without it,
+  // so other processes' lookups do not wait for the disk.
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> claimed;
+  {
+    SegmentLock lock(&header_->mutex);
+    for (std::uint32_t i = 0; i < header_->num_frames; ++i) {
+      Frame &frame = frames_[i];
+      if (frame.valid && frame.dirty && file.filename() == frame.filename) {
+        claimed.emplace_back(i, claim(frame));
+      }
+    }
+  }
+  std::exception_ptr error;
+  for (const std::pair<std::uint32_t, std::uint32_t> &frame : claimed) {
+    try {
+      writeBack(frame.first, frame.second);
+    } catch (...) {
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+std::size_t SharedBufferPool::segmentSize(const std::uint32_t num_frames,
+                                          const std::uint32_t table_size) {
+  return align(align(align(sizeof(Header)) + num_frames * sizeof(Frame)) +
+               table_size * sizeof(std::int32_t)) +
+         std::size_t(num_frames) * Page::SIZE;
+}
+
+void SharedBufferPool::locate() {
+  char *base = static_cast<char *>(segment_);
+  std::size_t offset = align(sizeof(Header));
+  frames_ = reinterpret_cast<Frame *>(base + offset);
+  offset = align(offset + header_->num_frames * sizeof(Frame));
+  table_ = reinterpret_cast<std::int32_t *>(base + offset);
+  offset = align(offset + header_->table_size * sizeof(std::int32_t));
+  images_ = base + offset;
+}
+
+std::int32_t SharedBufferPool::lookup(const std::string &filename,
+                                      const std::uint64_t hash,
+                                      const PageId page_number) const {
+  const std::uint32_t mask = header_->table_size - 1;
+  for (std::uint32_t slot = (hash ^ page_number * 0x9E3779B97F4A7C15ull) & mask;
+       table_[slot] != EMPTY_SLOT; slot = (slot + 1) & mask) {
+    const Frame &frame = frames_[table_[slot]];
+    if (frame.name_hash == hash && frame.page_number == page_number &&
+        filename == frame.filename) {
+      return table_[slot];
+    }
+  }
+  return EMPTY_SLOT;
+}
+
+void SharedBufferPool::insert(const std::uint32_t frame_number) {
+  const Frame &frame = frames_[frame_number];
+  const std::uint32_t mask = header_->table_size - 1;
+  std::uint32_t slot =
+      (frame.name_hash ^ frame.page_number * 0x9E3779B97F4A7C15ull) & mask;
+  while (table_[slot] != EMPTY_SLOT) {
+    slot = (slot + 1) & mask;
+  }
+  table_[slot] = frame_number;
+}
+
+void SharedBufferPool::erase(const std::uint32_t frame_number) {
+  const std::uint32_t mask = header_->table_size - 1;
+  const Frame &frame = frames_[frame_number];
+  std::uint32_t hole =
+      (frame.name_hash ^ frame.page_number * 0x9E3779B97F4A7C15ull) & mask;
+  while (table_[hole] != static_cast<std::int32_t>(frame_number)) {
+    hole = (hole + 1) & mask;
+  }
+  // Shift later entries of the probe sequence back over the hole, so that
+  // lookups never stop early at it.
+  table_[hole] = EMPTY_SLOT;
+  for (std::uint32_t slot = (hole + 1) & mask; table_[slot] != EMPTY_SLOT;
+       slot = (slot + 1) & mask) {
+    const Frame &moved = frames_[table_[slot]];
+    const std::uint32_t home =
+        (moved.name_hash ^ moved.page_number * 0x9E3779B97F4A7C15ull) & mask;
+    const bool reachable = hole < slot ? (hole < home && home <= slot)
+                                       : (hole < home || home <= slot);
+    if (!reachable) {
+      table_[hole] = table_[slot];
+      table_[slot] = EMPTY_SLOT;
+      hole = slot;
+    }
+  }
+}
+
+std::uint32_t SharedBufferPool::pin(File &file, const PageId page_number,
+                                    const bool exclusive,
+                                    const bool installing) {
+  const std::string &filename = file.filename();
+  if (filename.size() >= MAX_NAME) {
+    throw IoException(filename, "cache", ENAMETOOLONG);
+  }
+  const std::uint64_t hash = std::hash<std::string>()(filename);
+  for (;;) {
+    std::int32_t found;
+    std::uint32_t frame_number;
+    std::uint32_t dirty_sectors = 0;
+    {
+      SegmentLock lock(&header_->mutex);
+      found = lookup(filename, hash, page_number);
+      if (found != EMPTY_SLOT) {
+        frame_number = found;
+        frames_[frame_number].pin_count++;
+        frames_[frame_number].refbit = true;
+      } else {
+        frame_number = allocFrame(dirty_sectors);
+      }
+      if (found == EMPTY_SLOT && dirty_sectors == 0) {
+        Frame &frame = frames_[frame_number];
+        std::strcpy(frame.filename, filename.c_str());
+        frame.name_hash = hash;
+        frame.page_number = page_number;
+        frame.pin_count = 1;
+        frame.dirty_sectors = 0;
+        frame.valid = true;
+        frame.dirty = false;
+        frame.refbit = true;
+        // Unpinned frames are unlatched, so this does not block; other
+        // processes that find the page from now on wait until it is loaded.
+        pthread_rwlock_wrlock(&frame.latch);
+        insert(frame_number);
+      }
+    }
+    if (dirty_sectors != 0) {
+      // The victim was dirty and is written back without the pool mutex;
+      // look the page up again afterwards, as another process may have
+      // loaded it meanwhile.
+      writeBack(frame_number, dirty_sectors);
+      continue;
+    }
+    Frame &frame = frames_[frame_number];
+
+    if (found != EMPTY_SLOT) {
+      if (exclusive) {
+        pthread_rwlock_wrlock(&frame.latch);
+      } else {
+        pthread_rwlock_rdlock(&frame.latch);
+      }
+      if (frame.valid) {
+        return frame_number;
+      }
+      // Its load failed; start over, and fail the same way if it does.
+      pthread_rwlock_unlock(&frame.latch);
+      SegmentLock lock(&header_->mutex);
+      frame.pin_count--;
+      continue;
+    }
+
+    if (!installing) {
+      try {
+        copyIn(file.readPage(page_number),
+               images_ + std::size_t(frame_number) * Page::SIZE);
+      } catch (...) {
+        {
+          SegmentLock lock(&header_->mutex);
+          erase(frame_number);
+          frame.valid = false;
+          frame.pin_count--;
+        }
+        pthread_rwlock_unlock(&frame.latch);
+        throw;
+      }
+      if (!exclusive) {
+        pthread_rwlock_unlock(&frame.latch);
+        pthread_rwlock_rdlock(&frame.latch);
+      }
+    }
+    return frame_number;
+  }
+}
+
+void SharedBufferPool::unpin(const std::uint32_t frame_number,
+                             const std::uint32_t dirty_sectors) {
+  Frame &frame = frames_[frame_number];
+  // The latch is released first: the pool mutex is never held while waiting
+  // for a frame latch.
+  pthread_rwlock_unlock(&frame.latch);
+  SegmentLock lock(&header_->mutex);
+  if (dirty_sectors != 0) {
+    frame.dirty = true;
+    frame.dirty_sectors |= dirty_sectors;
+  }
+  frame.pin_count--;
+}
+
+std::uint32_t SharedBufferPool::allocFrame(std::uint32_t &dirty_sectors) {
+  const std::uint32_t num_frames = header_->num_frames;
+  for (std::uint32_t examined = 0; examined < 2 * num_frames; ++examined) {
+    const std::uint32_t frame_number = header_->clock_hand;
+    header_->clock_hand = (frame_number + 1) % num_frames;
+    Frame &frame = frames_[frame_number];
+    if (frame.pin_count != 0) {
+      continue;
+    }
+    if (!frame.valid) {
+      return frame_number;
+    }
+    if (frame.refbit) {
+      frame.refbit = false;
+      continue;
+    }
+    if (frame.dirty) {
+      dirty_sectors = claim(frame);
+      return frame_number;
+    }
+    erase(frame_number);
+    frame.valid = false;
+    return frame_number;
+  }
+  throw BufferExceededException();
+}
+
+std::uint32_t SharedBufferPool::claim(Frame &frame) {
+  const std::uint32_t dirty_sectors = frame.dirty_sectors;
+  frame.pin_count++;
+  frame.dirty = false;
+  frame.dirty_sectors = 0;
+  return dirty_sectors;
+}
+
+void SharedBufferPool::writeBack(const std::uint32_t frame_number,
+                                 const std::uint32_t dirty_sectors) {
+  Frame &frame = frames_[frame_number];
+  // The pin keeps the frame assigned to its page.  The shared latch keeps
+  // writers out until the write is done, so that a later write-back of a
+  // newer image cannot reach the file first.
+  pthread_rwlock_rdlock(&frame.latch);
+  Page page;
+  copyOut(images_ + std::size_t(frame_number) * Page::SIZE, page);
+  page.dirty_sectors_ = dirty_sectors;
+  try {
+    fileFor(frame.filename).writePage(page);
+  } catch (...) {
+    pthread_rwlock_unlock(&frame.latch);
+    SegmentLock lock(&header_->mutex);
+    frame.dirty = true;
+    frame.dirty_sectors |= dirty_sectors;
+    frame.pin_count--;
+    throw;
+  }
+  pthread_rwlock_unlock(&frame.latch);
+  SegmentLock lock(&header_->mutex);
+  frame.pin_count--;
+}
+
+File &SharedBufferPool::fileFor(const std::string &filename) {
+  std::lock_guard<std::mutex> lock(files_mutex_);
+  std::map<std::string, File>::iterator file = files_.find(filename);
+  if (file == files_.end()) {
+    file = files_.insert(std::make_pair(filename, File::open(filename))).first;
+  }
+  return file->second;
+}
+
+void SharedBufferPool::copyOut(const char *image, Page &page) {
+  std::memcpy(&page.header_, image, sizeof(page.header_));
+  page.data_.assign(image + sizeof(page.header_), Page::DATA_SIZE);
+  page.dirty_sectors_ = 0;
+}
+
+void SharedBufferPool::copyIn(const Page &page, char *image) {
+  std::memcpy(image, &page.header_, sizeof(page.header_));
+  std::memcpy(image + sizeof(page.header_), page.data_.data(),
+              Page::DATA_SIZE);
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,337 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <pthread.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Page cache shared by every process that attaches to it.
+ *
+ * The frames, their descriptors and the page table live in a POSIX shared
+ * memory segment, so worker processes that access the same files keep one
+ * copy of each page between them instead of one each, and see each other's
+ * changes as soon as they are made.  The page table and clock are guarded by
+ * a robust, process-shared mutex; each frame's contents by a process-shared
+ * reader/writer latch.  A frame being loaded is latched exclusively, so other
+ * processes wait for the load instead of reading the frame half-filled.  The
+ * mutex is never held across disk I/O: a dirty frame is claimed by pinning
+ * it, and written back under its shared latch only.
+ *
+ * Pages are identified by file name.  A dirty page is written back by
+ * whichever process evicts or flushes it, through its own File object for
+ * the name, so files must be named POSIX or MMAP files that every attached
+ * process can open.  Pages must only be allocated and deleted through File
+ * by one process at a time.
+ *
+ * Frames hold raw page images rather than Page objects, whose record data
+ * lives on the process heap, so pages are copied in and out under the frame
+ * latch.  A process that dies while holding the pool mutex does not wedge the
+ * pool, but pins it held are never released.  Frame latches cannot be made
+ * robust: a process that dies inside readPage(), writePage(), updatePage()
+ * or a write-back, holding a frame's latch, leaves that frame latched for
+ * good, and every process that then needs the page blocks.  A supervisor
+ * that sees a worker die abnormally must therefore treat the pool as lost:
+ * stop the other workers, remove() the segment and create a new one.  Pages
+ * that were dirty in the pool are lost; everything written back is in the
+ * files.
+ */
+class SharedBufferPool {
+ public:
+  /**
+   * Creates a shared memory segment holding an empty pool.
+   *
+   * @param name      Name of the segment, e.g. "/badgerdb-pool".
+   * @param numFrames Number of frames in the pool.
+   * @return  The pool, attached to the calling process.
+   * @throws  IoException  If the segment exists or cannot be created.
+   */
+  static std::shared_ptr<SharedBufferPool> create(
+      const std::string &name, const std::uint32_t numFrames);
+
+  /**
+   * Attaches to a pool created by another process (or this one).
+   *
+   * @param name  Name of the segment.
+   * @return  The pool.
+   * @throws  IoException  If no pool exists under the name.
+   */
+  static std::shared_ptr<SharedBufferPool> attach(const std::string &name);
+
+  /**
+   * Deletes the segment once every process has detached.  Dirty pages that
+   * were not flushed are lost.
+   *
+   * @param name  Name of the segment.
+   */
+  static void remove(const std::string &name);
+
+  /**
+   * Detaches from the segment.  The pool lives on in other processes.
+   */
+  ~SharedBufferPool();
+
+  SharedBufferPool(const SharedBufferPool &) = delete;
+  SharedBufferPool &operator=(const SharedBufferPool &) = delete;
+
+  /**
+   * Returns the number of frames in the pool.
+   */
+  std::uint32_t numFrames() const;
+
+  /**
+   * Copies a page out of the pool, reading it into a frame first if
+   * necessary.
+   *
+   * @param file        File object.
+   * @param page_number Number of the page.
+   * @param page        Page to copy into.
+   * @throws  BufferExceededException  If every frame is pinned.
+   */
+  void readPage(File &file, const PageId page_number, Page &page);
+
+  /**
+   * Copies a page into the pool and marks it dirty.  The page is written to
+   * the file when it is evicted or flushed.
+   *
+   * @param file  File object.
+   * @param page  Page to store; its dirty sectors are written back.
+   * @throws  BufferExceededException  If every frame is pinned.
+   */
+  void writePage(File &file, const Page &page);
+
+  /**
+   * Applies a read-modify-write to a page while holding its frame latch
+   * exclusively, so that updates from different processes do not overwrite
+   * each other.
+   *
+   * @param file        File object.
+   * @param page_number Number of the page.
+   * @param update      Modifies the page in place; must not call back into
+   *                    the pool.
+   * @throws  BufferExceededException  If every frame is pinned.
+   */
+  void updatePage(File &file, const PageId page_number,
+                  const std::function<void(Page &)> &update);
+
+  /**
+   * Writes every dirty page of the file to disk.  The pages stay cached.
+   *
+   * @param file  File object.
+   */
+  void flushFile(File &file);
+
+ private:
+  /**
+   * Longest file name a frame can record, including the terminator.
+   */
+  static const std::size_t MAX_NAME = 256;
+
+  /**
+   * Marks a page table slot as empty.
+   */
+  static const std::int32_t EMPTY_SLOT = -1;
+
+  /**
+   * @brief Start of the segment.
+   */
+  struct Header {
+    std::uint32_t magic;
+    std::uint32_t num_frames;
+    std::uint32_t table_size;
+    std::uint32_t clock_hand;
+    std::uint64_t segment_size;
+    std::atomic<std::uint32_t> ready;
+    pthread_mutex_t mutex;
+  };
+
+  /**
+   * @brief Descriptor of one frame.  Fields other than the latch are
+   * guarded by the pool mutex.
+   */
+  struct Frame {
+    char filename[MAX_NAME];
+    std::uint64_t name_hash;
+    PageId page_number;
+    std::uint32_t pin_count;
+    std::uint32_t dirty_sectors;
+    bool valid;
+    bool dirty;
+    bool refbit;
+    pthread_rwlock_t latch;
+  };
+
+  /**
+   * Maps the segment of an open shared memory object.
+   *
+   * @param name  Name of the segment.
+   * @param fd    Descriptor of the shared memory object; closed here.
+   * @param size  Size of the segment.
+   */
+  SharedBufferPool(const std::string &name, const int fd,
+                   const std::size_t size);
+
+  /**
+   * Returns the size of a segment with the given number of frames and page
+   * table slots.
+   */
+  static std::size_t segmentSize(const std::uint32_t num_frames,
+                                 const std::uint32_t table_size);
+
+  /**
+   * Points the member pointers into the mapped segment.
+   */
+  void locate();
+
+  /**
+   * Returns the frame holding a page, or EMPTY_SLOT.  Caller must hold the
+   * pool mutex.
+   */
+  std::int32_t lookup(const std::string &filename, const std::uint64_t hash,
+                      const PageId page_number) const;
+
+  /**
+   * Adds a frame to the page table.  Caller must hold the pool mutex.
+   */
+  void insert(const std::uint32_t frame_number);
+
+  /**
+   * Removes a frame from the page table.  Caller must hold the pool mutex.
+   */
+  void erase(const std::uint32_t frame_number);
+
+  /**
+   * Pins the frame holding a page, loading the page into a victim frame if
+   * necessary, and latches it in the requested mode.  When installing is
+   * true a missing page is not read: the frame is returned latched
+   * exclusively for the caller to fill.
+   *
+   * @param file        File object.
+   * @param page_number Number of the page.
+   * @param exclusive   Whether to latch the frame exclusively.
+   * @param installing  Whether the caller overwrites the whole page.
+   * @return  Number of the pinned and latched frame.
+   */
+  std::uint32_t pin(File &file, const PageId page_number, const bool exclusive,
+                    const bool installing);
+
+  /**
+   * Releases a frame latched and pinned by pin().
+   *
+   * @param frame_number  Number of the frame.
+   * @param dirty_sectors Sectors the caller changed, if any.
+   */
+  void unpin(const std::uint32_t frame_number,
+             const std::uint32_t dirty_sectors);
+
+  /**
+   * Picks an unpinned frame with the clock algorithm and removes it from the
+   * page table.  If the frame picked is dirty, it is claimed instead and
+   * left in the page table, for the caller to write back without the pool
+   * mutex and try again.  Caller must hold the pool mutex.
+   *
+   * @param dirty_sectors Sectors of a claimed frame are returned via this
+   *                      variable; left alone if the frame is free.
+   * @return  Number of the frame.
+   * @throws  BufferExceededException  If every frame is pinned.
+   */
+  std::uint32_t allocFrame(std::uint32_t &dirty_sectors);
+
+  /**
+   * Claims a dirty frame for writing back: pins it and marks it clean, so
+   * that changes made during the write mark it dirty again.  Caller must
+   * hold the pool mutex.
+   *
+   * @return  The frame's dirty sectors.
+   */
+  std::uint32_t claim(Frame &frame);
+
+  /**
+   * Writes a frame claimed with claim() back to its file and unpins it.  If
+   * the write fails, the sectors are marked dirty again.  Caller must not
+   * hold the pool mutex.
+   *
+   * @param frame_number  Number of the frame.
+   * @param dirty_sectors Sectors returned by claim().
+   */
+  void writeBack(const std::uint32_t frame_number,
+                 const std::uint32_t dirty_sectors);
+
+  /**
+   * Returns this process's File object for a name, opening it if needed.
+   */
+  File &fileFor(const std::string &filename);
+
+  /**
+   * Copies between a Page and a frame image.
+   */
+  static void copyOut(const char *image, Page &page);
+  static void copyIn(const Page &page, char *image);
+
+  /**
+   * Name of the segment.
+   */
+  std::string name_;
+
+  /**
+   * Mapped segment.
+   */
+  void *segment_;
+
+  /**
+   * Size of the mapped segment.
+   */
+  std::size_t size_;
+
+  /**
+   * Segment header.
+   */
+  Header *header_;
+
+  /**
+   * Frame descriptors.
+   */
+  Frame *frames_;
+
+  /**
+   * Page table: open addressing with linear probing over frame numbers.
+   */
+  std::int32_t *table_;
+
+  /**
+   * Page images, Page::SIZE bytes per frame.
+   */
+  char *images_;
+
+  /**
+   * Files this process opened to write back other processes' pages.
+   */
+  std::map<std::string, File> files_;
+
+  /**
+   * Guards files_.
+   */
+  std::mutex files_mutex_;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,156 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "shared_scan.h"
+
+#include <algorithm>
+
+#include "exceptions/invalid_page_exception.h"
+
+namespace badgerdb {
+
+int SharedScanCoordinator::activeScans(const std::string &filename) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  GroupMap::const_iterator group = groups_.find(filename);
+  return group == groups_.end() ? 0 : group->second.members;
+}
+
+std::size_t SharedScanCoordinator::attach(
+    const SharedScan *scan, File &file,
+    std::shared_ptr<const std::vector<PageId>> &pages) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    GroupMap::iterator group = groups_.find(file.filename());
+    if (group != groups_.end()) {
+      ++group->second.members;
+      group->second.progress[scan] = group->second.position;
+      pages = group->second.pages;
+      return group->second.position;
+    }
+  }
+
+  // No scan in progress; list the pages without holding the mutex, then
+  // start a group unless another scan beat us to it.
+  std::shared_ptr<std::vector<PageId>> order(new std::vector<PageId>());
+  bufMgr_->usedPages(file, *order);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  GroupMap::iterator group = groups_.find(file.filename());
+  if (group == groups_.end()) {
+    ScanGroup &created = groups_[file.filename()];
+    created.pages = order;
+    created.position = 0;
+    created.members = 0;
+    group = groups_.find(file.filename());
+  }
+  ++group->second.members;
+  group->second.progress[scan] = group->second.position;
+  pages = group->second.pages;
+  return group->second.position;
+}
+
+void SharedScanCoordinator::pace(const SharedScan *scan,
+                                 const std::string &filename,
+                                 const std::size_t position) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const auto caughtUp = [this, scan, &filename, position]() {
+    GroupMap::const_iterator group = groups_.find(filename);
+    if (group == groups_.end()) {
+      return true;
+    }
+    for (const auto &member : group->second.progress) {
+      if (member.first != scan && position > member.second + maxLead_) {
+        return false;
+      }
+    }
+    return true;
+  };
+  advanced_.wait_for(lock, maxWait_, caughtUp);
+}
+
+void SharedScanCoordinator::advance(const SharedScan *scan,
+                                    const std::string &filename,
+                                    const std::size_t position,
+                                    const bool finished) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    GroupMap::iterator group = groups_.find(filename);
+    if (group == groups_.end()) {
+      return;
+    }
+    group->second.position = std::max(group->second.position, position);
+    if (finished) {
+      group->second.progress.erase(scan);
+    } else {
+      group->second.progress[scan] = position + 1;
+    }
+  }
+  advanced_.notify_all();
+}
+
+void SharedScanCoordinator::detach(const SharedScan *scan,
+                                   const std::string &filename) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    GroupMap::iterator group = groups_.find(filename);
+    if (group == groups_.end()) {
+      return;
+    }
+    group->second.progress.erase(scan);
+    if (--group->second.members == 0) {
+      groups_.erase(group);
+    }
+  }
+  advanced_.notify_all();
+}
+
+SharedScan::SharedScan(SharedScanCoordinator &coordinator, File &file)
+    : coordinator_(coordinator),
+      file_(file),
+      visited_(0),
+      current_(Page::INVALID_NUMBER) {
+  start_ = coordinator_.attach(this, file_, pages_);
+}
+
+SharedScan::~SharedScan() {
+  release();
+  coordinator_.detach(this, file_.filename());
+}
+
+bool SharedScan::next(Page *&page) {
+  release();
+  while (visited_ < pages_->size()) {
+    const std::size_t position = start_ + visited_;
+    const PageId page_number = (*pages_)[position % pages_->size()];
+    coordinator_.pace(this, file_.filename(), position);
+    ++visited_;
+    bool found = true;
+    try {
+      coordinator_.bufMgr_->readPage(file_, page_number, page);
+    } catch (const InvalidPageException &) {
+      // Deleted since the scan order was fixed.
+      found = false;
+    }
+    coordinator_.advance(this, file_.filename(), position,
+                         visited_ == pages_->size());
+    if (found) {
+      current_ = page_number;
+      return true;
+    }
+  }
+  return false;
+}
+
+void SharedScan::release() {
+  if (current_ != Page::INVALID_NUMBER) {
+    coordinator_.bufMgr_->unPinPage(file_, current_, false);
+    current_ = Page::INVALID_NUMBER;
+  }
+}
+
+}  // namespace badgerdb
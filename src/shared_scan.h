@@ -0,0 +1,261 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+class SharedScan;
+
+/**
+ * @brief Lets concurrent full scans of the same file share their page reads.
+ *
+ * Scans of a file that overlap in time form a group.  The first scan of a
+ * group fixes the scan order (the file's used pages, in FileIterator order).
+ * Every later scan starts at the furthest page read by any member of the
+ * group, which is still in the buffer pool, travels along with the other
+ * members to the end of the file and then wraps around to pick up the pages
+ * it skipped.  N overlapping scans then cost close to one scan's worth of
+ * disk reads instead of N.
+ *
+ * Members are paced: a scan more than maxLead pages ahead of the slowest
+ * unfinished member of its group waits up to maxWait per page for it to
+ * catch up, so the pages the leader reads are still in the pool when the
+ * others get to them.  The wait is bounded, so a stalled member only slows
+ * the others down.
+ *
+ * Pages allocated after a group was formed are not seen by the scans in it,
+ * and pages deleted after it was formed are skipped.
+ */
+class SharedScanCoordinator {
+ public:
+  /**
+   * Constructs a coordinator for scans through the given buffer manager.
+   *
+   * @param bufMgr    Buffer manager the scans read pages through.
+   * @param maxLead   Pages a scan may run ahead of the slowest member of its
+   *                  group before it waits.
+   * @param maxWait   Longest a scan waits for the slowest member per page.
+   */
+  explicit SharedScanCoordinator(
+      BufMgr *bufMgr, const std::size_t maxLead = 32,
+      const std::chrono::microseconds maxWait = std::chrono::milliseconds(1))
+      : bufMgr_(bufMgr), maxLead_(maxLead), maxWait_(maxWait) {}
+
+  SharedScanCoordinator(const SharedScanCoordinator &) = delete;
+  SharedScanCoordinator &operator=(const SharedScanCoordinator &) = delete;
+
+  /**
+   * Returns the number of scans currently attached to the given file.
+   *
+   * @param filename  Name of the file.
+   */
+  int activeScans(const std::string &filename);
+
+ private:
+  friend class SharedScan;
+
+  /**
+   * @brief Scans of one file that overlap in time.
+   */
+  struct ScanGroup {
+    /**
+     * Scan order shared by the members.
+     */
+    std::shared_ptr<const std::vector<PageId>> pages;
+
+    /**
+     * Position of the furthest page read by any member.  Positions count
+     * pages from the start of the group's first pass without wrapping, so
+     * position % pages->size() is the index in pages; the position never
+     * moves backwards.
+     */
+    std::size_t position;
+
+    /**
+     * Number of attached scans.
+     */
+    int members;
+
+    /**
+     * Position of the next page of every unfinished member.
+     */
+    std::map<const SharedScan *, std::size_t> progress;
+  };
+
+  typedef std::map<std::string, ScanGroup> GroupMap;
+
+  /**
+   * Attaches a new scan to the group of the given file, creating the group if
+   * there is none.
+   *
+   * @param scan    The new scan.
+   * @param file    File to scan.
+   * @param pages   Scan order is returned via this variable.
+   * @return  Position at which the new scan starts.
+   */
+  std::size_t attach(const SharedScan *scan, File &file,
+                     std::shared_ptr<const std::vector<PageId>> &pages);
+
+  /**
+   * Waits, for at most maxWait, until a scan of the given file is no more
+   * than maxLead pages ahead of the slowest other unfinished member.
+   *
+   * @param scan      The scan.
+   * @param filename  Name of the file.
+   * @param position  Position of the page the scan is about to read.
+   */
+  void pace(const SharedScan *scan, const std::string &filename,
+            const std::size_t position);
+
+  /**
+   * Records that a scan of the given file has gone past the page at the
+   * given position.
+   *
+   * @param scan      The scan.
+   * @param filename  Name of the file.
+   * @param position  Position of the page.
+   * @param finished  True if the scan has visited every page.
+   */
+  void advance(const SharedScan *scan, const std::string &filename,
+               const std::size_t position, const bool finished);
+
+  /**
+   * Detaches a scan from the group of the given file, dissolving the group
+   * when it has no members left.
+   *
+   * @param scan      The scan.
+   * @param filename  Name of the file.
+   */
+  void detach(const SharedScan *scan, const std::string &filename);
+
+  /**
+   * Buffer manager the scans read pages through.
+   */
+  BufMgr *bufMgr_;
+
+  /**
+   * Pages a scan may run ahead of the slowest member of its group.
+   */
+  std::size_t maxLead_;
+
+  /**
+   * Longest a scan waits for the slowest member of its group per page.
+   */
+  std::chrono::microseconds maxWait_;
+
+  /**
+   * Scan groups, keyed by file name.
+   */
+  GroupMap groups_;
+
+  /**
+   * Guards groups_.
+   */
+  std::mutex mutex_;
+
+  /**
+   * Notified when a member of any group advances or detaches.
+   */
+  std::condition_variable advanced_;
+};
+
+/**
+ * @brief A full scan of a file that shares its page reads with concurrent
+ * scans of the same file.
+ *
+ * The scan visits every page of the file exactly once, but not necessarily
+ * starting with the first one; pages deleted since the scan order was fixed
+ * are skipped.  The page returned by next() stays pinned
+ * until the following call to next() or until the scan is destroyed.
+ *
+ * @warning This class is not threadsafe; use one SharedScan per thread.
+ */
+class SharedScan {
+ public:
+  /**
+   * Starts a scan of the given file.
+   *
+   * @param coordinator   Coordinator of the scans.
+   * @param file          File to scan.
+   */
+  SharedScan(SharedScanCoordinator &coordinator, File &file);
+
+  /**
+   * Unpins the current page and detaches the scan from its group.
+   */
+  ~SharedScan();
+
+  SharedScan(const SharedScan &) = delete;
+  SharedScan &operator=(const SharedScan &) = delete;
+
+  /**
+   * Unpins the current page and pins the next one.
+   *
+   * @param page  The next page is returned via this reference.
+   * @return  False if every page has been visited.
+   */
+  bool next(Page *&page);
+
+  /**
+   * Returns the number of the pinned page, or Page::INVALID_NUMBER.
+   */
+  PageId currentPageNumber() const { return current_; }
+
+ private:
+  /**
+   * Unpins the current page, if any.
+   */
+  void release();
+
+  /**
+   * Coordinator of the scans.
+   */
+  SharedScanCoordinator &coordinator_;
+
+  /**
+   * File being scanned.
+   */
+  File file_;
+
+  /**
+   * Scan order of the group.
+   */
+  std::shared_ptr<const std::vector<PageId>> pages_;
+
+  /**
+   * Position at which the scan started.
+   */
+  std::size_t start_;
+
+  /**
+   * Number of pages of the scan order visited or skipped so far.
+   */
+  std::size_t visited_;
+
+  /**
+   * Number of the pinned page, or Page::INVALID_NUMBER.
+   */
+  PageId current_;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,110 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "storage_backend.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "latency_storage.h"
+#include "memory_storage.h"
+#include "mmap_storage.h"
+#include "posix_storage.h"
+#include "segmented_storage.h"
+#include "striped_storage.h"
+
+namespace badgerdb {
+
+std::shared_ptr<StorageBackend> StorageBackend::open(
+    const std::string &name, const StorageOptions &options, const bool create) {
+  std::shared_ptr<StorageBackend> storage;
+  if (!options.stripeDirectories.empty()) {
+    storage = std::make_shared<StripedStorage>(name, options, create);
+  } else if (options.segmentSize > 0) {
+    storage = std::make_shared<SegmentedStorage>(name, options, create);
+  } else {
+    switch (options.kind) {
+      case StorageKind::POSIX:
+        storage =
+            std::make_shared<PosixStorage>(name, create, options.temporary);
+        break;
+      case StorageKind::MMAP:
+        storage =
+            std::make_shared<MmapStorage>(name, create, options.temporary);
+        break;
+      case StorageKind::MEMORY:
+        storage =
+            std::make_shared<MemoryStorage>(name, create, options.temporary);
+        break;
+    }
+  }
+  if (options.readLatency.count() > 0 || options.writeLatency.count() > 0) {
+    storage = std::make_shared<LatencyStorage>(storage, options.readLatency,
+                                               options.writeLatency);
+  }
+  return storage;
+}
+
+bool StorageBackend::exists(const std::string &name) {
+  return MemoryStorage::exists(name) || ::access(name.c_str(), F_OK) == 0;
+}
+
+void StorageBackend::remove(const std::string &name,
+                            const StorageOptions &options) {
+  for (std::size_t k = 1; k <= options.stripeDirectories.size(); ++k) {
+    remove(StripedStorage::stripeName(name, options, k));
+  }
+  // Only a segmented file owns <name>.1, <name>.2, ...; otherwise those are
+  // unrelated files.
+  for (std::uint64_t n = 0;
+       n == 0 || (options.segmentSize > 0 &&
+                  exists(SegmentedStorage::segmentName(name, n)));
+       ++n) {
+    const std::string segment = SegmentedStorage::segmentName(name, n);
+    if (!MemoryStorage::remove(segment)) {
+      std::remove(segment.c_str());
+    }
+  }
+}
+
+void StorageBackend::readv(const std::uint64_t offset, const IoBuffer *buffers,
+                           const std::size_t count) {
+  std::uint64_t position = offset;
+  for (std::size_t i = 0; i < count; ++i) {
+    read(position, buffers[i].data, buffers[i].length);
+    position += buffers[i].length;
+  }
+}
+
+void StorageBackend::writev(const std::uint64_t offset,
+                            const ConstIoBuffer *buffers,
+                            const std::size_t count) {
+  std::uint64_t position = offset;
+  for (std::size_t i = 0; i < count; ++i) {
+    write(position, buffers[i].data, buffers[i].length);
+    position += buffers[i].length;
+  }
+}
+
+void StorageBackend::punchHole(const std::uint64_t offset,
+                               const std::uint64_t length) {
+  const std::uint64_t end = std::min(offset + length, size());
+  const std::vector<char> zeros(
+      static_cast<std::size_t>(std::min<std::uint64_t>(length, 64 * 1024)));
+  for (std::uint64_t position = offset; position < end;
+       position += zeros.size()) {
+    write(position, zeros.data(),
+          static_cast<std::size_t>(
+              std::min<std::uint64_t>(end - position, zeros.size())));
+  }
+}
+
+}  // namespace badgerdb
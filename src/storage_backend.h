@@ -0,0 +1,244 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+ * @brief Kinds of storage a File can be backed by.
+ */
+enum class StorageKind {
+  /**
+   * Filesystem file accessed with pread/pwrite.
+   */
+  POSIX,
+
+  /**
+   * Filesystem file accessed through a shared memory mapping.
+   */
+  MMAP,
+
+  /**
+   * Process-local memory; contents last until the file is removed.
+   */
+  MEMORY
+};
+
+/**
+ * @brief How a file's storage is opened.
+ */
+struct StorageOptions {
+  /**
+   * Kind of storage.
+   */
+  StorageKind kind;
+
+  /**
+   * Simulated device latency added to every read request.
+   */
+  std::chrono::microseconds readLatency;
+
+  /**
+   * Simulated device latency added to every write request.
+   */
+  std::chrono::microseconds writeLatency;
+
+  /**
+   * Whether the storage is anonymous: a filesystem file is unlinked as soon
+   * as it is opened and memory contents are not registered by name, so the
+   * storage disappears once closed.
+   */
+  bool temporary;
+
+  /**
+   * Size in bytes of the segments the file is split into, or 0 to keep the
+   * file in one piece.  Must be the same every time the file is opened.
+   *
+   * @see SegmentedStorage
+   */
+  std::uint64_t segmentSize;
+
+  /**
+   * Directories holding further stripes of the file, or empty to keep the
+   * file in one stripe.  Must be the same every time the file is opened.
+   *
+   * @see StripedStorage
+   */
+  std::vector<std::string> stripeDirectories;
+
+  /**
+   * Number of consecutive bytes kept in one stripe.
+   */
+  std::uint64_t stripeChunk;
+
+  /**
+   * Constructs the default options: unsegmented, unstriped POSIX storage
+   * without added latency.
+   */
+  StorageOptions()
+      : kind(StorageKind::POSIX),
+        readLatency(0),
+        writeLatency(0),
+        temporary(false),
+        segmentSize(0),
+        stripeChunk(64 * 1024) {}
+};
+
+/**
+ * @brief Buffer of a vectored read.
+ */
+struct IoBuffer {
+  char *data;
+  std::size_t length;
+};
+
+/**
+ * @brief Buffer of a vectored write.
+ */
+struct ConstIoBuffer {
+  const char *data;
+  std::size_t length;
+};
+
+/**
+ * @brief Byte-addressed storage underneath a File.
+ *
+ * Requests are positioned, so a backend may be used by several threads at
+ * once.  Reads past the end of the storage return zeros; writes past the end
+ * extend it.  Failures are reported with IoException.
+ *
+ * Vectored requests transfer one contiguous range of the storage from or to
+ * several buffers.  Requests are synchronous; IoScheduler overlaps them.
+ */
+class StorageBackend {
+ public:
+  /**
+   * Opens the storage of a file.
+   *
+   * @param name      Name of the file.
+   * @param options   Kind of storage and simulated latencies.
+   * @param create    Whether to create the storage, discarding any existing
+   *                  contents.  Temporary storage is always created.
+   * @return  The storage.
+   * @throws  IoException  If the storage cannot be opened.
+   */
+  static std::shared_ptr<StorageBackend> open(const std::string &name,
+                                              const StorageOptions &options,
+                                              const bool create);
+
+  /**
+   * Returns whether storage of any kind exists under the given name.
+   *
+   * @param name  Name of the file.
+   */
+  static bool exists(const std::string &name);
+
+  /**
+   * Deletes the storage with the given name, including any further
+   * segments and stripes.  Must not be open.
+   *
+   * @param name    Name of the file.
+   * @param options Stripe directories and segment size of the file, if any.
+   */
+  static void remove(const std::string &name,
+                     const StorageOptions &options = StorageOptions());
+
+  virtual ~StorageBackend() {}
+
+  /**
+   * Reads a range of the storage.
+   *
+   * @param offset  Offset of the range.
+   * @param data    Buffer to read into.
+   * @param length  Length of the range.
+   */
+  virtual void read(const std::uint64_t offset, char *data,
+                    const std::size_t length) = 0;
+
+  /**
+   * Writes a range of the storage.
+   *
+   * @param offset  Offset of the range.
+   * @param data    Bytes to write.
+   * @param length  Length of the range.
+   */
+  virtual void write(const std::uint64_t offset, const char *data,
+                     const std::size_t length) = 0;
+
+  /**
+   * Reads a contiguous range of the storage into several buffers.
+   *
+   * @param offset  Offset of the range.
+   * @param buffers Buffers to fill, in order.
+   * @param count   Number of buffers.
+   */
+  virtual void readv(const std::uint64_t offset, const IoBuffer *buffers,
+                     const std::size_t count);
+
+  /**
+   * Writes several buffers to a contiguous range of the storage.
+   *
+   * @param offset  Offset of the range.
+   * @param buffers Buffers to write, in order.
+   * @param count   Number of buffers.
+   */
+  virtual void writev(const std::uint64_t offset, const ConstIoBuffer *buffers,
+                      const std::size_t count);
+
+  /**
+   * Makes completed writes durable.
+   */
+  virtual void sync() = 0;
+
+  /**
+   * Returns the size of the storage in bytes.
+   */
+  virtual std::uint64_t size() = 0;
+
+  /**
+   * Zeroes a range of the storage and releases the space it occupies where
+   * the storage supports it.  The size of the storage does not change.  By
+   * default, zeros are written over the part of the range within the
+   * storage.
+   *
+   * @param offset  Offset of the range.
+   * @param length  Length of the range.
+   */
+  virtual void punchHole(const std::uint64_t offset,
+                         const std::uint64_t length);
+
+  /**
+   * Discards the contents past the given size.  Does nothing if the storage
+   * is not larger.
+   *
+   * @param size  New size in bytes.
+   */
+  virtual void truncate(const std::uint64_t size) = 0;
+
+  /**
+   * Copies the storage to a new storage of the same kind under another
+   * name, to be opened with the same options.  Filesystem files are cloned
+   * copy-on-write where the filesystem supports it, which costs time
+   * proportional to their metadata rather than their data; otherwise they
+   * are copied on several threads.  Completed writes are included.
+   *
+   * @param name  Name of the copy; must not exist.
+   * @throws  IoException  If the copy cannot be made.
+   */
+  virtual void snapshot(const std::string &name) = 0;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,238 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "striped_storage.h"
+
+#include <algorithm>
+#include <exception>
+#include <future>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * @brief Part of a request that falls in one stripe.
+ */
+template <typename Data>
+struct Part {
+  std::uint64_t offset;
+  Data data;
+  std::size_t length;
+};
+
+void serve(StorageBackend &stripe, const Part<char *> &part) {
+  stripe.read(part.offset, part.data, part.length);
+}
+
+void serve(StorageBackend &stripe, const Part<const char *> &part) {
+  stripe.write(part.offset, part.data, part.length);
+}
+
+}  // namespace
+
+StripedStorage::StripedStorage(const std::string &name,
+                               const StorageOptions &options,
+                               const bool create)
+    : options_(options), chunk_(options.stripeChunk) {
+  // Latency is simulated once around the whole file.
+  StorageOptions stripe_options = options;
+  stripe_options.stripeDirectories.clear();
+  stripe_options.readLatency = std::chrono::microseconds(0);
+  stripe_options.writeLatency = std::chrono::microseconds(0);
+  for (std::size_t k = 0; k <= options.stripeDirectories.size(); ++k) {
+    // Only the first stripe decides whether the file exists; the others
+    // are created as needed.
+    const std::string stripe = stripeName(name, options, k);
+    stripes_.push_back(StorageBackend::open(
+        stripe, stripe_options,
+        create || (k > 0 && !StorageBackend::exists(stripe))));
+  }
+}
+
+std::string StripedStorage::stripeName(const std::string &name,
+                                       const StorageOptions &options,
+                                       const std::size_t stripe) {
+  if (stripe == 0) {
+    return name;
+  }
+  const std::string::size_type slash = name.find_last_of('/');
+  const std::string base =
+      slash == std::string::npos ? name : name.substr(slash + 1);
+  return options.stripeDirectories[stripe - 1] + "/" + base + ".stripe" +
+         std::to_string(stripe);
+}
+
+void StripedStorage::read(const std::uint64_t offset, char *data,
+                          const std::size_t length) {
+  const IoBuffer buffer = {data, length};
+  transfer(offset, &buffer, 1);
+}
+
+void StripedStorage::write(const std::uint64_t offset, const char *data,
+                           const std::size_t length) {
+  const ConstIoBuffer buffer = {data, length};
+  transfer(offset, &buffer, 1);
+}
+
+void StripedStorage::readv(const std::uint64_t offset, const IoBuffer *buffers,
+                           const std::size_t count) {
+  transfer(offset, buffers, count);
+}
+
+void StripedStorage::writev(const std::uint64_t offset,
+                            const ConstIoBuffer *buffers,
+                            const std::size_t count) {
+  transfer(offset, buffers, count);
+}
+
+void StripedStorage::sync() {
+  for (const std::shared_ptr<StorageBackend> &stripe : stripes_) {
+    stripe->sync();
+  }
+}
+
+std::uint64_t StripedStorage::size() {
+  const std::uint64_t num_stripes = stripes_.size();
+  std::uint64_t size = 0;
+  for (std::uint64_t k = 0; k < num_stripes; ++k) {
+    const std::uint64_t stripe_size = stripes_[k]->size();
+    if (stripe_size > 0) {
+      // The last byte of the stripe is the last byte of one of its chunks.
+      const std::uint64_t last = stripe_size - 1;
+      size = std::max(size, ((last / chunk_) * num_stripes + k) * chunk_ +
+                                last % chunk_ + 1);
+    }
+  }
+  return size;
+}
+
+void StripedStorage::punchHole(const std::uint64_t offset,
+                               const std::uint64_t length) {
+  const std::uint64_t num_stripes = stripes_.size();
+  std::uint64_t position = offset;
+  const std::uint64_t end = offset + length;
+  while (position < end) {
+    const std::uint64_t chunk = position / chunk_;
+    const std::uint64_t within = position % chunk_;
+    const std::uint64_t part =
+        std::min<std::uint64_t>(end - position, chunk_ - within);
+    stripes_[chunk % num_stripes]->punchHole(
+        (chunk / num_stripes) * chunk_ + within, part);
+    position += part;
+  }
+}
+
+void StripedStorage::truncate(const std::uint64_t size) {
+  const std::uint64_t num_stripes = stripes_.size();
+  const std::uint64_t full_chunks = size / chunk_;
+  for (std::uint64_t k = 0; k < num_stripes; ++k) {
+    // Each stripe keeps its share of the whole chunks, plus the partial
+    // chunk if it falls in this stripe.
+    std::uint64_t stripe_size = (full_chunks / num_stripes) * chunk_;
+    if (k < full_chunks % num_stripes) {
+      stripe_size += chunk_;
+    } else if (k == full_chunks % num_stripes) {
+      stripe_size += size % chunk_;
+    }
+    stripes_[k]->truncate(stripe_size);
+  }
+}
+
+void StripedStorage::snapshot(const std::string &name) {
+  // Stripes are on different devices, so they are copied in parallel.
+  std::vector<std::future<void>> copies;
+  for (std::size_t k = 0; k < stripes_.size(); ++k) {
+    StorageBackend *stripe = stripes_[k].get();
+    const std::string stripe_name = stripeName(name, options_, k);
+    copies.push_back(std::async(std::launch::async, [stripe, stripe_name]() {
+      stripe->snapshot(stripe_name);
+    }));
+  }
+  std::exception_ptr error;
+  for (std::future<void> &copy : copies) {
+    try {
+      copy.get();
+    } catch (...) {
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+template <typename Buffer>
+void StripedStorage::transfer(const std::uint64_t offset,
+                              const Buffer *buffers, const std::size_t count) {
+  typedef Part<decltype(buffers[0].data)> StripePart;
+  const std::uint64_t num_stripes = stripes_.size();
+  std::vector<std::vector<StripePart>> parts(num_stripes);
+  std::uint64_t position = offset;
+  for (std::size_t i = 0; i < count; ++i) {
+    std::size_t done = 0;
+    while (done < buffers[i].length) {
+      const std::uint64_t chunk = position / chunk_;
+      const std::uint64_t within = position % chunk_;
+      const std::size_t length = static_cast<std::size_t>(
+          std::min<std::uint64_t>(buffers[i].length - done, chunk_ - within));
+      const StripePart part = {(chunk / num_stripes) * chunk_ + within,
+                               buffers[i].data + done, length};
+      parts[chunk % num_stripes].push_back(part);
+      position += length;
+      done += length;
+    }
+  }
+
+  // Serve one stripe on this thread and the others on their own threads.
+  std::vector<std::future<void>> others;
+  const std::uint64_t none = num_stripes;
+  std::uint64_t local = none;
+  for (std::uint64_t k = 0; k < num_stripes; ++k) {
+    if (parts[k].empty()) {
+      continue;
+    }
+    StorageBackend *stripe = stripes_[k].get();
+    std::vector<StripePart> *stripe_parts = &parts[k];
+    if (local == none) {
+      local = k;
+      continue;
+    }
+    others.push_back(std::async(std::launch::async, [stripe, stripe_parts]() {
+      for (const StripePart &part : *stripe_parts) {
+        serve(*stripe, part);
+      }
+    }));
+  }
+  std::exception_ptr error;
+  if (local != none) {
+    try {
+      for (const StripePart &part : parts[local]) {
+        serve(*stripes_[local], part);
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+  }
+  for (std::future<void> &other : others) {
+    try {
+      other.get();
+    } catch (...) {
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,101 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "storage_backend.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Storage striped round-robin across several directories.
+ *
+ * The file is divided into chunks of StorageOptions::stripeChunk bytes.
+ * Chunk c goes to stripe c mod N, where N is one more than the number of
+ * stripe directories: stripe 0 is kept under the file's own name and stripe
+ * k in the k-th stripe directory.  Putting the directories on different
+ * devices lets one file use the bandwidth of all of them.
+ *
+ * A request that spans several stripes is split, and the parts for
+ * different stripes are served in parallel, one thread per stripe, so each
+ * device sees its own queue of requests.
+ */
+class StripedStorage : public StorageBackend {
+ public:
+  /**
+   * Opens every stripe.
+   *
+   * @param name    Name of the file.
+   * @param options Stripe directories, chunk size and the kind of storage of
+   *                each stripe.
+   * @param create  Whether to discard any existing contents.
+   * @throws  IoException  If a stripe cannot be opened.
+   */
+  StripedStorage(const std::string &name, const StorageOptions &options,
+                 const bool create);
+
+  /**
+   * Returns the name of a stripe of a file.
+   *
+   * @param name    Name of the file.
+   * @param options Stripe directories.
+   * @param stripe  Number of the stripe.
+   */
+  static std::string stripeName(const std::string &name,
+                                const StorageOptions &options,
+                                const std::size_t stripe);
+
+  void read(const std::uint64_t offset, char *data,
+            const std::size_t length) override;
+  void write(const std::uint64_t offset, const char *data,
+             const std::size_t length) override;
+  void readv(const std::uint64_t offset, const IoBuffer *buffers,
+             const std::size_t count) override;
+  void writev(const std::uint64_t offset, const ConstIoBuffer *buffers,
+              const std::size_t count) override;
+  void sync() override;
+  std::uint64_t size() override;
+  void punchHole(const std::uint64_t offset,
+                 const std::uint64_t length) override;
+  void truncate(const std::uint64_t size) override;
+  void snapshot(const std::string &name) override;
+
+ private:
+  /**
+   * Splits a request into per-stripe parts and serves them.
+   *
+   * @param offset  Offset of the range in the file.
+   * @param buffers Buffers to read into or write from, in order.
+   * @param count   Number of buffers.
+   */
+  template <typename Buffer>
+  void transfer(const std::uint64_t offset, const Buffer *buffers,
+                const std::size_t count);
+
+  /**
+   * Options the file was opened with, which name its stripes.
+   */
+  StorageOptions options_;
+
+  /**
+   * Size of a chunk in bytes.
+   */
+  std::uint64_t chunk_;
+
+  /**
+   * Stripes, by number.
+   */
+  std::vector<std::shared_ptr<StorageBackend>> stripes_;
+};
+
+}  // namespace badgerdb
@@ -8,14 +8,26 @@
 
 #pragma once
 
+#include <cinttypes>
 #include <cstdint>
 
 namespace badgerdb {
 
 /**
  * @brief Identifier for a page in a file.
+ *
+ * Page numbers are 32 bits wide unless built with BADGERDB_LARGE_PAGE_IDS
+ * defined, which allows files of more than 2^32 pages (e.g. in segmented
+ * storage) at the cost of an incompatible on-disk format.  Format page
+ * numbers with PRIuPAGEID, e.g. printf("%" PRIuPAGEID, page_number).
  */
+#ifdef BADGERDB_LARGE_PAGE_IDS
+typedef std::uint64_t PageId;
+#define PRIuPAGEID PRIu64
+#else
 typedef std::uint32_t PageId;
+#define PRIuPAGEID PRIu32
+#endif
 
 /**
  * @brief Identifier for a slot in a page.